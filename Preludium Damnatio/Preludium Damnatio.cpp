@@ -3,21 +3,27 @@
 #include "input_manager.h"
 #include "render_manager.h"
 #include "audio_manager.h"
+#include "autoplay_driver.h"
+#include "choice_policy.h"
+#include "autosave_writer.h"
+#include "frame_recorder.h"
+#include "prepared_image.h"
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <iostream>
-#include <direct.h>  // Include this for _getcwd
 #include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 #define SDL_MAIN_HANDLED
 
 // Declare the Cleanup function
-void Cleanup(SDL_Renderer* renderer, SDL_Window* window, TTF_Font* font) {
-    // Close font if it was created
-    if (font) {
-        TTF_CloseFont(font);
-        font = nullptr; // This line won't affect the class member 'font', but it's fine here.
-    }
+void Cleanup(SDL_Renderer* renderer, SDL_Window* window, RenderManager& renderManager) {
+    // Close the font and free the textures while the renderer still exists
+    renderManager.Shutdown();
 
     // Destroy renderer and window
     if (renderer) {
@@ -33,18 +39,249 @@ void Cleanup(SDL_Renderer* renderer, SDL_Window* window, TTF_Font* font) {
     SDL_Quit();
 }
 
+// Load the story, preferring the compiled form written by the story compiler
+// unless the story was edited after it was compiled
+bool LoadGameStory(StoryManager& storyManager) {
+    const std::string storyPath = "assets/stories/preludium damnatio.story";
+    const std::string compiledPath = storyPath + "c";
+    return storyManager.LoadStory(IsBuiltFileCurrent(compiledPath, storyPath) ? compiledPath : storyPath);
+}
+
+// Start on the soundtrack the story had reached, if a node set one
+void StartSoundtrack(StoryManager& storyManager, AudioManager& audioManager) {
+    const std::string soundtrackPath = "assets/audio/Combat in the Ruins.wav";
+    std::string_view music = storyManager.GetPlayingMusic();
+    audioManager.PlayAudioLoop(music.empty() ? soundtrackPath : std::string(music));
+}
+
+// Play the sound of the node just reached and fade over to its soundtrack, if it changes it
+void PlayNodeAudio(StoryManager& storyManager, AudioManager& audioManager) {
+    const int musicCrossfadeMs = 1500;
+    if (storyManager.NeedsAudio()) {
+        audioManager.PlayAudio(storyManager.GetCurrentAudio());
+    }
+    if (!storyManager.GetCurrentMusic().empty()) {
+        audioManager.CrossfadeMusic(storyManager.GetCurrentMusic(), musicCrossfadeMs);
+    }
+}
+
+// Play one game without a window, taking choices from a policy:
+//   --headless [--policy random|roundrobin|scripted:1,2,3] [--seed N] [--turns N] [--load file] [--save file]
+int RunHeadless(int argc, char* argv[]) {
+    std::string policyName = "random";
+    unsigned int seed = 1;
+    int maxTurns = 1000;
+    std::string loadFile;
+    std::string saveFile;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--policy" && i + 1 < argc) {
+            policyName = argv[++i];
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--turns" && i + 1 < argc) {
+            maxTurns = std::atoi(argv[++i]);
+        }
+        else if (arg == "--load" && i + 1 < argc) {
+            loadFile = argv[++i];
+        }
+        else if (arg == "--save" && i + 1 < argc) {
+            saveFile = argv[++i];
+        }
+    }
+
+    std::unique_ptr<ChoicePolicy> policy = CreateChoicePolicy(policyName, seed);
+    if (!policy) {
+        std::cerr << "Unknown choice policy: " << policyName << std::endl;
+        return -1;
+    }
+
+    // A RenderManager without a renderer turns every draw into a no-op
+    InputManager inputManager;
+    RenderManager renderManager(nullptr);
+    StoryManager storyManager(inputManager, renderManager);
+    if (!LoadGameStory(storyManager)) {
+        return -1;
+    }
+    storyManager.SetRandomSeed(seed);
+    if (!loadFile.empty() && !storyManager.LoadGame(loadFile)) {
+        std::cerr << "Could not resume from " << loadFile << std::endl;
+        return -1;
+    }
+
+    AutoplayDriver driver(storyManager, *policy);
+    int turns = 0;
+    std::cout << "Turn 0: " << storyManager.GetCurrentNodeName() << std::endl;
+    while (turns < maxTurns && !storyManager.IsGameOver()) {
+        driver.PlayTurn();
+        ++turns;
+        if (!storyManager.IsGameOver()) {
+            std::cout << "Turn " << turns << ": " << storyManager.GetCurrentNodeName() << std::endl;
+        }
+    }
+    std::cout << (storyManager.IsGameOver() ? "Game over after " : "Stopped after ") << turns << " choices." << std::endl;
+    if (!saveFile.empty() && !storyManager.SaveGame(saveFile)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Play one game drawing every frame with the software renderer into a
+// surface, with no window or GPU, and report where the frame time went:
+//   --offscreen [--policy random|roundrobin|scripted:1,2,3] [--seed N] [--turns N]
+//               [--redraws N] [--dump directory] [--golden directory]
+//               [--tolerance N] [--allowed-pixels N] [--audio]
+// Each node is drawn once, then redrawn --redraws more times (steady state).
+// --dump writes every frame as a BMP; --golden compares every frame with the
+// BMP of the same name and fails if any differ. --tolerance lets each color
+// channel be off by up to N, and --allowed-pixels lets up to N pixels differ
+// beyond that, for golden images made with other FreeType or SDL versions.
+// --audio also plays the story's sound and music (SDL_AUDIODRIVER=dummy needs
+// no sound card) and reports how often the music ran dry.
+int RunOffscreen(int argc, char* argv[]) {
+    std::string policyName = "random";
+    unsigned int seed = 1;
+    int maxTurns = 100;
+    int redraws = 0;
+    std::string dumpDirectory;
+    std::string goldenDirectory;
+    int tolerance = 0;
+    long long allowedPixels = 0;
+    bool playAudio = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--policy" && i + 1 < argc) {
+            policyName = argv[++i];
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--turns" && i + 1 < argc) {
+            maxTurns = std::atoi(argv[++i]);
+        }
+        else if (arg == "--redraws" && i + 1 < argc) {
+            redraws = std::atoi(argv[++i]);
+        }
+        else if (arg == "--dump" && i + 1 < argc) {
+            dumpDirectory = argv[++i];
+        }
+        else if (arg == "--golden" && i + 1 < argc) {
+            goldenDirectory = argv[++i];
+        }
+        else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atoi(argv[++i]);
+        }
+        else if (arg == "--allowed-pixels" && i + 1 < argc) {
+            allowedPixels = std::atoll(argv[++i]);
+        }
+        else if (arg == "--audio") {
+            playAudio = true;
+        }
+    }
+
+    std::unique_ptr<ChoicePolicy> policy = CreateChoicePolicy(policyName, seed);
+    if (!policy) {
+        std::cerr << "Unknown choice policy: " << policyName << std::endl;
+        return -1;
+    }
+
+    // The software renderer draws into a surface, so no video driver is needed
+    if (SDL_Init(0) < 0 || TTF_Init() == -1) {
+        std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
+        SDL_Quit();
+        return -1;
+    }
+    SDL_Surface* frame = SDL_CreateRGBSurfaceWithFormat(0, 1300, 1000, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = frame ? SDL_CreateSoftwareRenderer(frame) : nullptr;
+    if (!renderer) {
+        std::cerr << "Failed to create the software renderer: " << SDL_GetError() << std::endl;
+        SDL_FreeSurface(frame);
+        TTF_Quit();
+        SDL_Quit();
+        return -1;
+    }
+
+    int result = 0;
+    {
+        InputManager inputManager;
+        RenderManager renderManager(renderer);
+        StoryManager storyManager(inputManager, renderManager);
+        if (!LoadGameStory(storyManager) || !renderManager.LoadFont("assets/fonts/BonaNovaSC-Regular.ttf", 18)) {
+            result = -1;
+        }
+        else {
+            storyManager.SetRandomSeed(seed);
+            AutoplayDriver driver(storyManager, *policy);
+            FrameRecorder recorder(dumpDirectory, goldenDirectory);
+            recorder.SetTolerance(tolerance, allowedPixels);
+            std::unique_ptr<AudioManager> audioManager;
+            if (playAudio) {
+                audioManager = std::make_unique<AudioManager>();
+                audioManager->PreloadSounds(storyManager.GetAudioFiles());
+                StartSoundtrack(storyManager, *audioManager);
+            }
+            int turns = 0;
+            while (true) {
+                for (int i = 0; i <= redraws; ++i) {
+                    renderManager.Clear();
+                    storyManager.DisplayCurrentNode();
+                    renderManager.Present();
+                    recorder.AddFrame(frame, renderManager.GetFrameTimings());
+                }
+                if (turns == maxTurns || storyManager.IsGameOver()) {
+                    break;
+                }
+                driver.PlayTurn();
+                ++turns;
+                if (audioManager) {
+                    PlayNodeAudio(storyManager, *audioManager);
+                }
+            }
+            recorder.PrintReport(std::cout);
+            if (audioManager) {
+                AudioStats audio = audioManager->GetStats();
+                if (!audio.deviceOpen) {
+                    std::cout << "Audio: no device" << std::endl;
+                }
+                else {
+                    std::cout << "Audio: " << audio.sounds << " sounds (" << audio.soundBytes << " bytes), "
+                        << audio.musicUnderruns << " music underruns" << std::endl;
+                }
+            }
+            result = recorder.GetMismatchCount() == 0 ? 0 : 1;
+        }
+        renderManager.Shutdown();
+    }
+
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(frame);
+    TTF_Quit();
+    SDL_Quit();
+    return result;
+}
+
 
 int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--headless") {
+            return RunHeadless(argc, argv);
+        }
+        if (std::string(argv[i]) == "--offscreen") {
+            return RunOffscreen(argc, argv);
+        }
+    }
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
         return -1;
     }
 
-    // Get and print the current working directory
-    char cwd[1024];
-    if (_getcwd(cwd, sizeof(cwd)) != NULL) {
-    }
-    else {
+    // Get the current working directory
+    std::error_code cwdError;
+    std::filesystem::path cwd = std::filesystem::current_path(cwdError);
+    if (cwdError) {
         SDL_Quit();
         return -1;
     }
@@ -82,24 +319,32 @@ int main(int argc, char* argv[]) {
     AudioManager audioManager;
 
     if (!renderManager.IsInitialized()) {
-        Cleanup(renderer, window, renderManager.GetFont());
+        Cleanup(renderer, window, renderManager);
         return -1;
     }
 
     // Load the story
-    storyManager.LoadStory();
+    if (!LoadGameStory(storyManager)) {
+        Cleanup(renderer, window, renderManager);
+        return -1;
+    }
 
-    // Construct the path to the font file
-    std::string fontPath = std::string(cwd) + "\\assets\\fonts\\BonaNovaSC-Regular.ttf";
+    // Decode the story's sound effects now rather than when they are first played
+    audioManager.PreloadSounds(storyManager.GetAudioFiles());
 
-    // Check if the font file can be opened
-    FILE* file;
-    if (fopen_s(&file, fontPath.c_str(), "r") == 0) {
-        fclose(file);
+    // Pick up where the last session left off
+    const std::string autosavePath = "autosave.sav";
+    if (storyManager.LoadGame(autosavePath)) {
+        std::cout << "Resumed from autosave." << std::endl;
     }
+    AutosaveWriter autosave(autosavePath);
+    std::vector<uint8_t> snapshot;
+
+    // Construct the path to the font file
+    std::string fontPath = (cwd / "assets" / "fonts" / "BonaNovaSC-Regular.ttf").string();
 
     if (!renderManager.LoadFont(fontPath.c_str(), 18)) {
-        Cleanup(renderer, window, renderManager.GetFont());
+        Cleanup(renderer, window, renderManager);
         return -1;
     }
 
@@ -112,48 +357,93 @@ int main(int argc, char* argv[]) {
     SDL_RaiseWindow(window); // Brings the SDL window to the front
     SDL_SetWindowFullscreen(window, 0); // Optionally remove fullscreen if previously set
 
-    std::string soundtrackPath = "assets\\audio\\Combat in the Ruins.wav";
-    audioManager.PlayAudioLoop(soundtrackPath);
+    // Start on the soundtrack the story had reached, if a node set one
+    StartSoundtrack(storyManager, audioManager);
 
-    while (true) {
+    // Sleep until an event arrives; the timeout only bounds how long a wakeup can be missed
+    const int idleWaitMs = 250;
+    bool running = true;
+    bool needsRedraw = false;
+    while (running) {
         SDL_Event e; // Create an SDL event variable
+        if (!SDL_WaitEventTimeout(&e, idleWaitMs)) {
+            continue; // Idle
+        }
 
-        // Handle events
-        while (SDL_PollEvent(&e)) {
+        // Handle this event and everything queued behind it before drawing.
+        // Only one choice is taken per batch: input after it was aimed at
+        // the options of the node it left, which are still on screen.
+        bool choiceTaken = false;
+        do {
             if (e.type == SDL_QUIT) {
-                // Handle the quit event
-                Cleanup(renderer, window, renderManager.GetFont());
-                std::cout << "Cleaned up and exited." << std::endl;
-                return 0;
+                running = false;
+                break;
+            }
+
+            // Redraw when the window was uncovered or resized
+            if (e.type == SDL_WINDOWEVENT &&
+                (e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+                needsRedraw = true;
+                continue;
             }
-        }
 
-        renderManager.Clear();  // Clear screen at the start of each loop
+            // The retained scene texture lost its content
+            if (e.type == SDL_RENDER_TARGETS_RESET) {
+                renderManager.InvalidateScene();
+                needsRedraw = true;
+                continue;
+            }
 
-        // Get player choice based on current options
-        int choice = inputManager.GetPlayerChoice(storyManager.GetCurrentOptions().size());
-        storyManager.HandleChoice(choice);
+            // Every texture was lost (e.g. the Direct3D device was reset)
+            if (e.type == SDL_RENDER_DEVICE_RESET) {
+                renderManager.RecreateTextures();
+                needsRedraw = true;
+                continue;
+            }
 
-        // Check if the current node is empty or a game-ending node
-        if (storyManager.IsGameOver()) {  // Assume `IsGameOver()` is a method in StoryManager
-            Cleanup(renderer, window, renderManager.GetFont());
-            break;  // Exit the game loop if it's game over
-        }
+            // A number key or a click on an option picks it
+            int choice = inputManager.GetEventChoice(e, storyManager.GetOptionBoxes());
+            if (choice == 0 || choiceTaken) {
+                continue;
+            }
+            try {
+                if (choice > storyManager.GetCurrentOptionCount()) {
+                    continue; // Not an option of the node on screen
+                }
+                storyManager.HandleChoice(choice);
+            }
+            catch (const std::out_of_range& error) {
+                std::cerr << "Ignoring choice " << choice << ": " << error.what() << std::endl;
+                continue;
+            }
+            choiceTaken = true;
 
-        // Display the current node based on the choice made
-        storyManager.DisplayCurrentNode();
+            // Check if the current node is empty or a game-ending node
+            if (storyManager.IsGameOver()) {
+                autosave.Remove(); // The next session starts a new game
+                running = false;
+                break;  // Exit the game loop if it's game over
+            }
 
-        // Play audio if needed
-        if (storyManager.NeedsAudio()) {
-            audioManager.PlayAudio(storyManager.GetCurrentAudio());
-            std::cout << "Played audio." << std::endl;
-        }
+            // Save progress in the background after every choice
+            storyManager.SaveSnapshot(snapshot);
+            autosave.Submit(snapshot);
 
-        renderManager.Present(); // Present rendered content to the screen
-        std::cout << "Presented content to the screen." << std::endl;
+            // Play the node's sound and fade over to its soundtrack
+            PlayNodeAudio(storyManager, audioManager);
+            needsRedraw = true;
+        } while (SDL_PollEvent(&e));
+
+        if (running && needsRedraw) {
+            renderManager.Clear();
+            storyManager.DisplayCurrentNode();
+            renderManager.Present();
+            needsRedraw = false;
+        }
     }
 
     // Clean up and quit after breaking the loop
-    Cleanup(renderer, window, renderManager.GetFont());
+    Cleanup(renderer, window, renderManager);
+    std::cout << "Cleaned up and exited." << std::endl;
     return 0;
 }
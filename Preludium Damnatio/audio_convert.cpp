@@ -0,0 +1,314 @@
+#include "audio_convert.h"
+#include "audio_mixer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Filter length when raising the rate; lowering it lengthens the filter
+    // in proportion, to keep the same transition band at the lower rate
+    const int BaseTaps = 16;
+    const int MaxTaps = 256;
+
+    // Above this many output positions between two inputs, the nearest filter is used
+    const uint64_t MaxPhases = 256;
+
+    // Pass band edge, as a fraction of the lower rate's Nyquist frequency
+    const double PassBand = 0.92;
+
+    const double Pi = 3.14159265358979323846;
+
+    double Sinc(double x) {
+        return x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+    }
+
+    // Blackman window over (-half, half)
+    double Blackman(double x, double half) {
+        if (std::fabs(x) >= half) {
+            return 0.0;
+        }
+        return 0.42 + 0.5 * std::cos(Pi * x / half) + 0.08 * std::cos(2.0 * Pi * x / half);
+    }
+
+    // Apply one filter to both channels
+    void FilterFrame(const float* filter, const float* left, const float* right, int taps, float& outLeft, float& outRight) {
+#ifdef AUDIO_CONVERT_SSE2
+        __m128 sumLeft = _mm_setzero_ps();
+        __m128 sumRight = _mm_setzero_ps();
+        for (int k = 0; k < taps; k += 4) {
+            __m128 coefficients = _mm_loadu_ps(filter + k);
+            sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(coefficients, _mm_loadu_ps(left + k)));
+            sumRight = _mm_add_ps(sumRight, _mm_mul_ps(coefficients, _mm_loadu_ps(right + k)));
+        }
+        // Add across the lanes of both sums together
+        __m128 sums = _mm_add_ps(_mm_unpacklo_ps(sumLeft, sumRight), _mm_unpackhi_ps(sumLeft, sumRight));
+        sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+        outLeft = _mm_cvtss_f32(sums);
+        outRight = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, 1));
+#else
+        float sumLeft = 0.0f;
+        float sumRight = 0.0f;
+        for (int k = 0; k < taps; ++k) {
+            sumLeft += filter[k] * left[k];
+            sumRight += filter[k] * right[k];
+        }
+        outLeft = sumLeft;
+        outRight = sumRight;
+#endif
+    }
+}
+
+AudioConverter::AudioConverter()
+    : format(AUDIO_S16SYS),
+    channels(AudioMixer::Channels),
+    sampleSize(sizeof(int16_t)),
+    resampling(false),
+    upFactor(1),
+    downFactor(1),
+    phaseCount(1),
+    taps(0),
+    position(0),
+    phase(0),
+    inputFrames(0),
+    outputFrames(0)
+{
+}
+
+// Set up for a source format
+bool AudioConverter::Start(SDL_AudioFormat sourceFormat, int sourceChannels, int rate) {
+    int bits = SDL_AUDIO_BITSIZE(sourceFormat);
+    if (bits != 8 && bits != 16 && bits != 32) {
+        return false;
+    }
+    if (SDL_AUDIO_ISFLOAT(sourceFormat) && bits != 32) {
+        return false;
+    }
+    if (sourceChannels <= 0 || rate <= 0) {
+        return false;
+    }
+
+    format = sourceFormat;
+    channels = sourceChannels;
+    sampleSize = static_cast<size_t>(bits / 8);
+
+    uint64_t common = std::gcd(static_cast<uint64_t>(rate), static_cast<uint64_t>(AudioMixer::SampleRate));
+    upFactor = AudioMixer::SampleRate / common;
+    downFactor = static_cast<uint64_t>(rate) / common;
+    resampling = upFactor != downFactor;
+    filters.clear();
+    taps = 0;
+    phaseCount = 1;
+
+    if (resampling) {
+        // Cut off below the Nyquist frequency of whichever rate is lower
+        double cutoff = PassBand * std::min(1.0, static_cast<double>(upFactor) / static_cast<double>(downFactor));
+        taps = static_cast<int>(std::ceil(BaseTaps / cutoff));
+        taps = std::min((taps + 3) & ~3, MaxTaps);
+        phaseCount = static_cast<int>(std::min(upFactor, MaxPhases));
+
+        // Filter p is centred p / phaseCount of the way past tap taps / 2 - 1,
+        // and scaled so that each passes a constant signal unchanged
+        double half = taps / 2;
+        filters.resize(static_cast<size_t>(phaseCount) * taps);
+        std::vector<double> values(taps);
+        for (int p = 0; p < phaseCount; ++p) {
+            double offset = static_cast<double>(p) / phaseCount;
+            float* filter = filters.data() + static_cast<size_t>(p) * taps;
+            double sum = 0.0;
+            for (int k = 0; k < taps; ++k) {
+                double x = k - (half - 1.0) - offset;
+                values[k] = cutoff * Sinc(cutoff * x) * Blackman(x, half);
+                sum += values[k];
+            }
+            for (int k = 0; k < taps; ++k) {
+                filter[k] = static_cast<float>(values[k] / sum);
+            }
+        }
+    }
+
+    Reset();
+    return true;
+}
+
+// Forget earlier input, as at the start of a sound
+void AudioConverter::Reset() {
+    // Silence before the sound, so the first output's filter has something to cover
+    size_t lead = resampling ? static_cast<size_t>(taps / 2 - 1) : 0;
+    input[0].assign(lead, 0.0f);
+    input[1].assign(lead, 0.0f);
+    position = 0;
+    phase = 0;
+    inputFrames = 0;
+    outputFrames = 0;
+    output.clear();
+}
+
+size_t AudioConverter::GetFrameSize() const {
+    return sampleSize * static_cast<size_t>(channels);
+}
+
+// Convert whole source frames and append the result to samples
+void AudioConverter::Convert(const uint8_t* data, size_t bytes, std::vector<int16_t>& samples) {
+    size_t frames = bytes / GetFrameSize();
+    Decode(data, frames);
+    inputFrames += frames;
+
+    if (resampling) {
+        Resample(std::numeric_limits<uint64_t>::max());
+    }
+    else {
+        for (size_t i = 0; i < input[0].size(); ++i) {
+            output.push_back(input[0][i]);
+            output.push_back(input[1][i]);
+        }
+        input[0].clear();
+        input[1].clear();
+    }
+    Emit(samples);
+}
+
+// At the end of the sound: append what was held back, and start over
+void AudioConverter::Finish(std::vector<int16_t>& samples) {
+    if (resampling) {
+        // Silence after the sound lets the last filters run; stop at the output frame for the end of the input
+        input[0].insert(input[0].end(), static_cast<size_t>(taps), 0.0f);
+        input[1].insert(input[1].end(), static_cast<size_t>(taps), 0.0f);
+        Resample((inputFrames * upFactor + downFactor - 1) / downFactor);
+        Emit(samples);
+    }
+    Reset();
+}
+
+// Append frames of source audio to the planar input, in 16-bit units
+void AudioConverter::Decode(const uint8_t* data, size_t frames) {
+    size_t start = input[0].size();
+    input[0].resize(start + frames);
+    input[1].resize(start + frames);
+    float* left = input[0].data() + start;
+    float* right = input[1].data() + start;
+    size_t frameSize = GetFrameSize();
+
+    size_t frame = 0;
+#ifdef AUDIO_CONVERT_SSE2
+    // The usual case: each 32-bit lane holds one little-endian stereo frame
+    if (format == AUDIO_S16LSB && channels == 2) {
+        for (; frame + 4 <= frames; frame += 4) {
+            __m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + frame * frameSize));
+            _mm_storeu_ps(left + frame, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16)));
+            _mm_storeu_ps(right + frame, _mm_cvtepi32_ps(_mm_srai_epi32(pairs, 16)));
+        }
+    }
+#endif
+    for (; frame < frames; ++frame) {
+        const uint8_t* bytes = data + frame * frameSize;
+        left[frame] = DecodeSample(bytes);
+        right[frame] = channels > 1 ? DecodeSample(bytes + sampleSize) : left[frame];
+    }
+}
+
+float AudioConverter::DecodeSample(const uint8_t* bytes) const {
+    uint32_t raw = 0;
+    if (SDL_AUDIO_ISBIGENDIAN(format)) {
+        for (size_t i = 0; i < sampleSize; ++i) {
+            raw = (raw << 8) | bytes[i];
+        }
+    }
+    else {
+        for (size_t i = sampleSize; i-- > 0;) {
+            raw = (raw << 8) | bytes[i];
+        }
+    }
+
+    bool isSigned = SDL_AUDIO_ISSIGNED(format);
+    if (sampleSize == 1) {
+        return isSigned ? static_cast<int8_t>(raw) * 256.0f : (static_cast<int>(raw) - 128) * 256.0f;
+    }
+    if (sampleSize == 2) {
+        return isSigned ? static_cast<float>(static_cast<int16_t>(raw)) : static_cast<float>(static_cast<int>(raw) - 32768);
+    }
+    if (SDL_AUDIO_ISFLOAT(format)) {
+        float value;
+        std::memcpy(&value, &raw, sizeof(value));
+        return value * 32768.0f;
+    }
+    return static_cast<int32_t>(raw) / 65536.0f;
+}
+
+// Filter as many output frames as the input allows, up to lastFrame
+void AudioConverter::Resample(uint64_t lastFrame) {
+    const size_t available = input[0].size();
+    while (outputFrames < lastFrame) {
+        // Round to the nearest filter; rounding up past the last one is filter 0 at the next input
+        uint64_t bank = phase;
+        size_t start = position;
+        if (phaseCount != static_cast<int>(upFactor)) {
+            bank = (phase * phaseCount + upFactor / 2) / upFactor;
+            if (bank == static_cast<uint64_t>(phaseCount)) {
+                bank = 0;
+                ++start;
+            }
+        }
+        if (start + static_cast<size_t>(taps) > available) {
+            break;
+        }
+
+        const float* filter = filters.data() + bank * taps;
+        float left;
+        float right;
+        FilterFrame(filter, input[0].data() + start, input[1].data() + start, taps, left, right);
+        output.push_back(left);
+        output.push_back(right);
+        ++outputFrames;
+
+        phase += downFactor;
+        position += static_cast<size_t>(phase / upFactor);
+        phase %= upFactor;
+    }
+
+    // Drop the input no later filter reaches
+    size_t used = std::min(position, available);
+    input[0].erase(input[0].begin(), input[0].begin() + used);
+    input[1].erase(input[1].begin(), input[1].begin() + used);
+    position -= used;
+}
+
+// Convert the filtered output to 16 bits and append it to samples
+void AudioConverter::Emit(std::vector<int16_t>& samples) {
+    size_t count = output.size();
+    size_t start = samples.size();
+    samples.resize(start + count);
+    int16_t* out = samples.data() + start;
+
+    size_t i = 0;
+#ifdef AUDIO_CONVERT_SSE2
+    const __m128 lowest = _mm_set1_ps(-32768.0f);
+    const __m128 highest = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(output.data() + i), lowest), highest));
+        __m128i high = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(output.data() + i + 4), lowest), highest));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = static_cast<int16_t>(std::lrint(std::clamp(output[i], -32768.0f, 32767.0f)));
+    }
+    output.clear();
+}
+
+// Convert a whole sound to the mixer's format at once
+bool ConvertAudio(const uint8_t* data, size_t bytes, SDL_AudioFormat format, int channels, int rate, std::vector<int16_t>& samples) {
+    AudioConverter converter;
+    if (!converter.Start(format, channels, rate)) {
+        return false;
+    }
+    converter.Convert(data, bytes, samples);
+    converter.Finish(samples);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef AUDIO_CONVERT_H
+#define AUDIO_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <SDL.h>
+
+// Converts PCM audio of any sample format, channel count and rate to the
+// mixer's format (16-bit stereo at AudioMixer::SampleRate). Rates are changed
+// with a polyphase windowed sinc filter. The conversion keeps its state
+// between calls, so a sound can be converted whole at load time or a chunk
+// at a time while it streams, with the same result. Mono is played on both
+// sides; of more channels, the front left and right are kept.
+class AudioConverter {
+public:
+    AudioConverter();
+
+    // Set up for a source format: 8, 16 or 32-bit integer or 32-bit float
+    // samples, either byte order. Returns false if it is not supported.
+    bool Start(SDL_AudioFormat format, int channels, int rate);
+
+    // Convert whole source frames and append the result to samples. Up to
+    // half the filter's length is held back until the frames after it arrive.
+    void Convert(const uint8_t* data, size_t bytes, std::vector<int16_t>& samples);
+
+    // At the end of the sound: append what was held back, and start over
+    void Finish(std::vector<int16_t>& samples);
+
+    // Bytes in one source frame
+    size_t GetFrameSize() const;
+
+private:
+    // Forget earlier input, as at the start of a sound
+    void Reset();
+
+    // Append frames of source audio to the planar input, in 16-bit units
+    void Decode(const uint8_t* data, size_t frames);
+    float DecodeSample(const uint8_t* bytes) const;
+
+    // Filter as many output frames as the input allows, up to lastFrame
+    void Resample(uint64_t lastFrame);
+
+    // Convert the filtered output to 16 bits and append it to samples
+    void Emit(std::vector<int16_t>& samples);
+
+    SDL_AudioFormat format;
+    int channels;
+    size_t sampleSize;      // Bytes per source sample
+    bool resampling;        // The source rate differs from the mixer's
+    uint64_t upFactor;      // Output rate / input rate = upFactor / downFactor, in lowest terms
+    uint64_t downFactor;
+    int phaseCount;         // Filters in the bank, one per output position between two inputs
+    int taps;               // Length of each filter, a multiple of 4
+    std::vector<float> filters;
+
+    std::vector<float> input[2]; // Left and right input not used up yet
+    size_t position;        // First input of the next output's filter
+    uint64_t phase;         // Where the next output falls after that input, in 1/upFactor steps
+    uint64_t inputFrames;   // Since the start of the sound
+    uint64_t outputFrames;
+    std::vector<float> output; // Interleaved, waiting for Emit
+};
+
+// Convert a whole sound to the mixer's format at once
+bool ConvertAudio(const uint8_t* data, size_t bytes, SDL_AudioFormat format, int channels, int rate, std::vector<int16_t>& samples);
+
+#endif // AUDIO_CONVERT_H
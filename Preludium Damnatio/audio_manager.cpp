@@ -1,74 +1,102 @@
 #include "audio_manager.h"
+#include <algorithm>
 #include <iostream>
-#include <thread>
 
-// Constructor
+namespace {
+    // Short enough to feel immediate, long enough not to click
+    const int DeclickMilliseconds = 20;
+}
+
 // Constructor
 AudioManager::AudioManager()
-    : wavBuffer(nullptr), wavLength(0), deviceId(0) // Initialize member variables
+    : freedUnderruns(0),
+    volume(AudioMixer::FullVolume)
 {
-    // Initialize wavSpec to default values
-    wavSpec.freq = 44100;               // Default frequency
-    wavSpec.format = AUDIO_S16SYS;      // Default audio format
-    wavSpec.channels = 2;                // Default number of channels (stereo)
-    wavSpec.samples = 4096;             // Default buffer size
-    wavSpec.callback = nullptr;          // No callback function
-    wavSpec.userdata = nullptr;          // No user data
-
     // Initialize SDL audio
-    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+        return;
     }
-    volume = 10;
+    mixer.Open();
 }
 
 
 // Destructor
 AudioManager::~AudioManager() {
-    SDL_CloseAudioDevice(deviceId);
-    SDL_Quit();
+    mixer.Close(); // Stop the callback before the sound bank goes away
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
 }
 
-// Load audio file
+// Load audio file into the sound bank, once; later calls reuse it
 bool AudioManager::LoadAudio(const std::string& filename) {
-    if (SDL_LoadWAV(filename.c_str(), &wavSpec, &wavBuffer, &wavLength) == nullptr) {
-        return false;
-    }
-    deviceId = SDL_OpenAudioDevice(nullptr, 0, &wavSpec, nullptr, 0);
-    return true;
+    return sounds.Load(filename) != SoundBank::NoSound;
 }
 
-// Play loaded audio once
-void AudioManager::PlayAudio(const std::string& filename) {
-    if (!LoadAudio(filename)) {
-        return; // Exit if loading fails
-    }
+// Load every sound effect the game will play up front
+void AudioManager::PreloadSounds(const std::vector<std::string>& filenames) {
+    sounds.LoadAll(filenames);
+}
 
-    SDL_QueueAudio(deviceId, wavBuffer, wavLength); // Queue the audio to play
-    SDL_PauseAudioDevice(deviceId, 0); // Start playback
+// Play loaded audio once
+void AudioManager::PlayAudio(std::string_view filename) {
+    PlaySoundEffect(filename);
 }
 
-// Play audio in a loop
+// Play audio in a loop, streamed from disk as the music track
 void AudioManager::PlayAudioLoop(const std::string& filename) {
-    if (!LoadAudio(filename)) {
-        return; // Exit if loading fails
+    StartMusic(filename, 0);
+}
+
+// Fade the music track over to another; does nothing if it is already playing
+void AudioManager::CrossfadeMusic(std::string_view filename, int milliseconds) {
+    if (filename == musicFile) {
+        return;
     }
+    StartMusic(std::string(filename), milliseconds);
+}
 
-    std::thread([this]() {
-        SDL_PauseAudioDevice(deviceId, 0); // Start playback
-        while (true) {
-            SDL_QueueAudio(deviceId, wavBuffer, wavLength); // Queue audio for looping
-            SDL_PauseAudioDevice(deviceId, 0); // Ensure playback starts again
+// Open a music track and crossfade to it over milliseconds
+void AudioManager::StartMusic(const std::string& filename, int milliseconds) {
+    if (!mixer.IsOpen()) {
+        return;
+    }
+    FreeReleasedStreams();
 
-            // Wait until the audio has finished playing
-            SDL_Delay(wavLength / wavSpec.freq * 1000); // Convert length from samples to milliseconds
+    std::unique_ptr<AudioStream> stream = std::make_unique<AudioStream>();
+    if (!stream->Open(filename, true)) {
+        return; // Exit if loading fails; the old track plays on
+    }
+    if (!mixer.CrossfadeMusic(stream.get(), AudioMixer::FullVolume, AudioMixer::MillisecondsToFrames(milliseconds))) {
+        std::cerr << "Audio command queue full, music not changed: " << filename << std::endl;
+        return; // The mixer never saw the stream
+    }
+
+    // The mixer marks the old stream released once it has faded out
+    streams.push_back(std::move(stream));
+    musicFile = filename;
+}
+
+// Destroy the streams the mixer has stopped playing
+void AudioManager::FreeReleasedStreams() {
+    for (const std::unique_ptr<AudioStream>& stream : streams) {
+        if (stream->IsReleased()) {
+            freedUnderruns += stream->GetUnderrunCount();
         }
-        }).detach(); // Detach the thread to run independently
+    }
+    streams.erase(std::remove_if(streams.begin(), streams.end(),
+        [](const std::unique_ptr<AudioStream>& stream) { return stream->IsReleased(); }), streams.end());
 }
 
-// Play sound effect
-void AudioManager::PlaySoundEffect(const std::string& filename) {
-    // Existing code for sound effect handling
+// Play sound effect; loads it first if it was not preloaded
+void AudioManager::PlaySoundEffect(std::string_view filename) {
+    if (!sounds.Contains(filename)) {
+        sounds.Load(std::string(filename));
+    }
+    int sound = sounds.Find(filename);
+    if (sound == SoundBank::NoSound) {
+        return; // Exit if loading failed
+    }
+    mixer.PlayEffect(sounds.GetClip(sound));
 }
 
 // Set volume (0 to 128)
@@ -78,23 +106,30 @@ void AudioManager::SetVolume(int newVolume) {
     if (newVolume > 128) newVolume = 128;
 
     volume = newVolume; // Update the internal volume level
-
-    // Set the volume for the audio device
-    SDL_MixAudioFormat(nullptr, nullptr, wavSpec.format, 0, volume); // This line sets the volume level
+    mixer.SetMasterVolume(volume, AudioMixer::MillisecondsToFrames(DeclickMilliseconds));
 }
 
 
+AudioStats AudioManager::GetStats() const {
+    AudioStats stats = { mixer.IsOpen(), sounds.GetSoundCount(), sounds.GetArenaBytes(), freedUnderruns };
+    for (const std::unique_ptr<AudioStream>& stream : streams) {
+        stats.musicUnderruns += stream->GetUnderrunCount();
+    }
+    return stats;
+}
+
 // Stop playing audio
 void AudioManager::StopAudio() {
-    SDL_ClearQueuedAudio(deviceId); // Clear any queued audio
+    mixer.StopAll(AudioMixer::MillisecondsToFrames(DeclickMilliseconds));
+    musicFile.clear();
 }
 
 // Pause audio
 void AudioManager::PauseAudio() {
-    SDL_PauseAudioDevice(deviceId, 1); // Pause playback
+    mixer.Pause(true);
 }
 
 // Resume audio
 void AudioManager::ResumeAudio() {
-    SDL_PauseAudioDevice(deviceId, 0); // Resume playback
+    mixer.Pause(false);
 }
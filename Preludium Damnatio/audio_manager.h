@@ -1,9 +1,22 @@
 #ifndef AUDIO_MANAGER_H
 #define AUDIO_MANAGER_H
 
+#include "audio_mixer.h"
+#include "audio_stream.h"
+#include "sound_bank.h"
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <SDL.h>
-#include <thread>
+#include <string_view>
+#include <vector>
+
+// What the audio has done so far
+struct AudioStats {
+    bool deviceOpen;            // False if no audio device could be opened
+    size_t sounds;              // Sound effects decoded into the sound bank
+    size_t soundBytes;          // Bytes of decoded sound effects
+    uint64_t musicUnderruns;    // Times the music ran dry because the disk could not keep up
+};
 
 class AudioManager {
 public:
@@ -13,17 +26,24 @@ public:
     // Destructor
     ~AudioManager();
 
-    // Load audio file
+    // Load audio file into the sound bank, once; later calls reuse it
     bool LoadAudio(const std::string& filename);
 
+    // Load every sound effect the game will play up front (e.g. the story's node audio)
+    void PreloadSounds(const std::vector<std::string>& filenames);
+
     // Play loaded audio once
-    void PlayAudio(const std::string& filename);
+    void PlayAudio(std::string_view filename);
 
-    // Play audio in a loop
+    // Play audio in a loop, streamed from disk as the music track
     void PlayAudioLoop(const std::string& filename);
 
-    // Play sound effect
-    void PlaySoundEffect(const std::string& filename);
+    // Fade the music track over to another over milliseconds; does nothing
+    // if that track is already playing
+    void CrossfadeMusic(std::string_view filename, int milliseconds);
+
+    // Play sound effect; loads it first if it was not preloaded
+    void PlaySoundEffect(std::string_view filename);
 
     // Set volume (0 to 128)
     void SetVolume(int volume);
@@ -37,11 +57,23 @@ public:
     // Resume audio
     void ResumeAudio();
 
+    AudioStats GetStats() const;
+
 private:
-    SDL_AudioSpec wavSpec;      // Structure for audio specification
-    Uint8* wavBuffer;           // Pointer to audio buffer
-    Uint32 wavLength;           // Length of the audio buffer
-    SDL_AudioDeviceID deviceId; // Audio device ID for playback
+    // Open a music track and crossfade to it over milliseconds
+    void StartMusic(const std::string& filename, int milliseconds);
+
+    // Destroy the streams the mixer has stopped playing
+    void FreeReleasedStreams();
+
+    // Decoded effects. Voices play from its arena, so it lives as long as the mixer
+    SoundBank sounds;
+    // Music streams the mixer may still be playing or fading out. Declared
+    // before the mixer, so the device is closed before they are destroyed.
+    std::vector<std::unique_ptr<AudioStream>> streams;
+    std::string musicFile;      // The track playing or fading in
+    uint64_t freedUnderruns;    // Underruns of the streams already destroyed
+    AudioMixer mixer;
     int volume;                 // Volume level (0-128)
 };
 
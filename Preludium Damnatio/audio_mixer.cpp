@@ -0,0 +1,459 @@
+#include "audio_mixer.h"
+#include "audio_stream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_MIXER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Frames per device buffer: about 23 ms at 44.1 kHz
+    const Uint16 DeviceFrames = 1024;
+
+    // Add stereo frames to the accumulator, the first scaled by gain and each
+    // one after by step more. The sum is kept in floating point so any number
+    // of voices can be added without clipping until SaturateSamples.
+    void AccumulateSamples(float* accumulator, const int16_t* samples, size_t frames, float gain, float step) {
+        size_t frame = 0;
+#ifdef AUDIO_MIXER_SSE2
+        // Four frames at a time; each vector holds two, so gains go in pairs
+        __m128 gains = _mm_setr_ps(gain, gain, gain + step, gain + step);
+        const __m128 advance = _mm_set1_ps(2.0f * step);
+        for (; frame + 4 <= frames; frame += 4) {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + frame * 2));
+            __m128 first = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(input, input), 16));
+            __m128 second = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(input, input), 16));
+            float* sums = accumulator + frame * 2;
+            _mm_storeu_ps(sums, _mm_add_ps(_mm_loadu_ps(sums), _mm_mul_ps(first, gains)));
+            gains = _mm_add_ps(gains, advance);
+            _mm_storeu_ps(sums + 4, _mm_add_ps(_mm_loadu_ps(sums + 4), _mm_mul_ps(second, gains)));
+            gains = _mm_add_ps(gains, advance);
+        }
+        gain = _mm_cvtss_f32(gains);
+#endif
+        for (; frame < frames; ++frame) {
+            accumulator[frame * 2] += samples[frame * 2] * gain;
+            accumulator[frame * 2 + 1] += samples[frame * 2 + 1] * gain;
+            gain += step;
+        }
+    }
+
+    // Scale the accumulated frames by the master gain (ramped like a voice's)
+    // and convert them to 16 bits, clamping what overflows
+    void SaturateSamples(const float* accumulator, int16_t* output, size_t frames, float gain, float step) {
+        size_t frame = 0;
+#ifdef AUDIO_MIXER_SSE2
+        __m128 gains = _mm_setr_ps(gain, gain, gain + step, gain + step);
+        const __m128 advance = _mm_set1_ps(2.0f * step);
+        const __m128 lowest = _mm_set1_ps(-32768.0f);
+        const __m128 highest = _mm_set1_ps(32767.0f);
+        for (; frame + 4 <= frames; frame += 4) {
+            __m128 first = _mm_mul_ps(_mm_loadu_ps(accumulator + frame * 2), gains);
+            gains = _mm_add_ps(gains, advance);
+            __m128 second = _mm_mul_ps(_mm_loadu_ps(accumulator + frame * 2 + 4), gains);
+            gains = _mm_add_ps(gains, advance);
+            __m128i low = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(first, lowest), highest));
+            __m128i high = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(second, lowest), highest));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + frame * 2), _mm_packs_epi32(low, high));
+        }
+        gain = _mm_cvtss_f32(gains);
+#endif
+        for (; frame < frames; ++frame) {
+            for (int channel = 0; channel < 2; ++channel) {
+                float sample = accumulator[frame * 2 + channel] * gain;
+                output[frame * 2 + channel] = static_cast<int16_t>(std::lrint(std::clamp(sample, -32768.0f, 32767.0f)));
+            }
+            gain += step;
+        }
+    }
+
+    // Set a gain moving linearly to target over frames (at once if frames is 0)
+    void StartRamp(float& gain, float& target, float& step, uint32_t& rampFrames, float newTarget, uint32_t frames) {
+        target = newTarget;
+        rampFrames = frames;
+        if (frames == 0) {
+            gain = newTarget;
+            step = 0.0f;
+        }
+        else {
+            step = (newTarget - gain) / static_cast<float>(frames);
+        }
+    }
+
+    // Move a gain frames along its ramp, landing exactly on the target at the end
+    void AdvanceRamp(float& gain, float target, float step, uint32_t& rampFrames, size_t frames) {
+        if (frames >= rampFrames) {
+            gain = target;
+            rampFrames = 0;
+        }
+        else {
+            gain += step * static_cast<float>(frames);
+            rampFrames -= static_cast<uint32_t>(frames);
+        }
+    }
+
+    float VolumeToGain(int volume) {
+        return static_cast<float>(std::clamp(volume, 0, int(AudioMixer::FullVolume))) / AudioMixer::FullVolume;
+    }
+}
+
+AudioMixer::CommandQueue::CommandQueue()
+    : pushed(0), popped(0) {
+}
+
+// Game thread: queue a command unless the queue is full
+bool AudioMixer::CommandQueue::Push(const Command& command) {
+    size_t count = pushed.load(std::memory_order_relaxed);
+    if (count - popped.load(std::memory_order_acquire) == Capacity) {
+        return false;
+    }
+    commands[count % Capacity] = command;
+    pushed.store(count + 1, std::memory_order_release);
+    return true;
+}
+
+// Audio thread: take the oldest command, if any
+bool AudioMixer::CommandQueue::Pop(Command& command) {
+    size_t count = popped.load(std::memory_order_relaxed);
+    if (count == pushed.load(std::memory_order_acquire)) {
+        return false;
+    }
+    command = commands[count % Capacity];
+    popped.store(count + 1, std::memory_order_release);
+    return true;
+}
+
+AudioMixer::AudioMixer()
+    : device(0),
+    currentMusic(MusicVoice),
+    masterGain(1.0f),
+    masterTarget(1.0f),
+    masterStep(0.0f),
+    masterRampFrames(0),
+    paused(false),
+    playCount(0)
+{
+    for (Voice& voice : voices) {
+        voice = { AudioClip(), nullptr, 0, false, 1.0f, 1.0f, 0.0f, 0, false, 0 };
+    }
+}
+
+AudioMixer::~AudioMixer() {
+    Close();
+}
+
+// Open the default device in the mixer's format and start it
+bool AudioMixer::Open() {
+    if (device != 0) {
+        return true;
+    }
+
+    SDL_AudioSpec desired = {};
+    desired.freq = SampleRate;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = Channels;
+    desired.samples = DeviceFrames;
+    desired.callback = Callback;
+    desired.userdata = this;
+
+    // With no allowed changes SDL converts to whatever the hardware wants
+    SDL_AudioSpec obtained;
+    device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
+    if (device == 0) {
+        std::cerr << "Failed to open audio device! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    accumulator.assign(static_cast<size_t>(std::max<Uint16>(obtained.samples, 1)) * Channels, 0.0f);
+    streamBlock.assign(accumulator.size(), 0);
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void AudioMixer::Close() {
+    if (device != 0) {
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+// Start a clip from its beginning on a voice, replacing what it played
+bool AudioMixer::Play(int voice, const AudioClip& clip, bool loop, int volume, uint32_t fadeFrames) {
+    if (voice < 0 || voice >= VoiceCount) {
+        return false;
+    }
+    AudioClip playing = clip;
+    if (!playing.samples || playing.frames == 0) {
+        playing = AudioClip(); // Nothing to play, and a looping empty clip would never advance
+    }
+    return commands.Push({ Command::Type::Play, voice, playing, nullptr, loop, VolumeToGain(volume), fadeFrames });
+}
+
+// Play a stream on a voice, replacing what it played
+bool AudioMixer::PlayStream(int voice, AudioStream* stream, int volume, uint32_t fadeFrames) {
+    if (voice < 0 || voice >= VoiceCount) {
+        return false;
+    }
+    return commands.Push({ Command::Type::Play, voice, AudioClip(), stream, false, VolumeToGain(volume), fadeFrames });
+}
+
+// Play a clip once on a free effect voice, or the one that started longest ago
+bool AudioMixer::PlayEffect(const AudioClip& clip, int volume) {
+    if (!clip.samples || clip.frames == 0) {
+        return false;
+    }
+    return commands.Push({ Command::Type::PlayEffect, FirstEffectVoice, clip, nullptr, false, VolumeToGain(volume), 0 });
+}
+
+// Fade the current music out and the stream in on the other music voice
+bool AudioMixer::CrossfadeMusic(AudioStream* stream, int volume, uint32_t frames) {
+    return commands.Push({ Command::Type::CrossfadeMusic, MusicVoice, AudioClip(), stream, false, VolumeToGain(volume), frames });
+}
+
+// Ramp a voice's volume over rampFrames
+bool AudioMixer::SetVolume(int voice, int volume, uint32_t rampFrames) {
+    if (voice < 0 || voice >= VoiceCount) {
+        return false;
+    }
+    return commands.Push({ Command::Type::SetVolume, voice, AudioClip(), nullptr, false, VolumeToGain(volume), rampFrames });
+}
+
+// Fade a voice out over fadeFrames and stop it
+bool AudioMixer::Stop(int voice, uint32_t fadeFrames) {
+    if (voice < 0 || voice >= VoiceCount) {
+        return false;
+    }
+    return commands.Push({ Command::Type::Stop, voice, AudioClip(), nullptr, false, 0.0f, fadeFrames });
+}
+
+bool AudioMixer::StopAll(uint32_t fadeFrames) {
+    return commands.Push({ Command::Type::StopAll, 0, AudioClip(), nullptr, false, 0.0f, fadeFrames });
+}
+
+// Ramp the volume of everything the mixer plays
+bool AudioMixer::SetMasterVolume(int volume, uint32_t rampFrames) {
+    return commands.Push({ Command::Type::SetMasterVolume, 0, AudioClip(), nullptr, false, VolumeToGain(volume), rampFrames });
+}
+
+// Hold every voice where it is and play silence, or carry on
+bool AudioMixer::Pause(bool pause) {
+    Command::Type type = pause ? Command::Type::Pause : Command::Type::Resume;
+    return commands.Push({ type, 0, AudioClip(), nullptr, false, 0.0f, 0 });
+}
+
+uint32_t AudioMixer::MillisecondsToFrames(int milliseconds) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(std::max(milliseconds, 0)) * SampleRate / 1000);
+}
+
+void SDLCALL AudioMixer::Callback(void* userdata, Uint8* stream, int length) {
+    AudioMixer* mixer = static_cast<AudioMixer*>(userdata);
+    mixer->ApplyCommands();
+    if (mixer->paused) {
+        std::memset(stream, 0, static_cast<size_t>(length));
+        return;
+    }
+    size_t frames = static_cast<size_t>(length) / (sizeof(int16_t) * Channels);
+    mixer->Mix(reinterpret_cast<int16_t*>(stream), frames);
+}
+
+// Audio thread: apply everything queued since the last buffer
+void AudioMixer::ApplyCommands() {
+    Command command;
+    while (commands.Pop(command)) {
+        Apply(command);
+    }
+}
+
+void AudioMixer::Apply(const Command& command) {
+    switch (command.type) {
+    case Command::Type::Play:
+        StartVoice(command.voice, command.clip, command.stream, command.loop, command.gain, command.frames);
+        break;
+
+    case Command::Type::PlayEffect: {
+        int chosen = FirstEffectVoice;
+        for (int i = FirstEffectVoice; i < VoiceCount; ++i) {
+            if (!voices[i].IsPlaying()) {
+                chosen = i;
+                break;
+            }
+            if (voices[i].started < voices[chosen].started) {
+                chosen = i;
+            }
+        }
+        StartVoice(chosen, command.clip, nullptr, false, command.gain, 0);
+        break;
+    }
+
+    case Command::Type::CrossfadeMusic: {
+        // The old track fades out where it is; the new one starts on the other
+        // music voice, cutting off anything still fading out there
+        Voice& outgoing = voices[currentMusic];
+        if (command.frames == 0) {
+            StopVoice(outgoing);
+        }
+        else if (outgoing.IsPlaying()) {
+            StartRamp(outgoing.gain, outgoing.targetGain, outgoing.gainStep, outgoing.rampFrames, 0.0f, command.frames);
+            outgoing.stopAfterRamp = true;
+        }
+        if (command.stream) {
+            int incoming = currentMusic == MusicVoice ? MusicVoice + 1 : MusicVoice;
+            StartVoice(incoming, AudioClip(), command.stream, false, command.gain, command.frames);
+        }
+        break;
+    }
+
+    case Command::Type::SetVolume: {
+        Voice& voice = voices[command.voice];
+        StartRamp(voice.gain, voice.targetGain, voice.gainStep, voice.rampFrames, command.gain, command.frames);
+        voice.stopAfterRamp = false;
+        break;
+    }
+
+    case Command::Type::Stop:
+    case Command::Type::StopAll:
+        for (int i = 0; i < VoiceCount; ++i) {
+            if (command.type == Command::Type::Stop && i != command.voice) {
+                continue;
+            }
+            Voice& voice = voices[i];
+            if (command.frames == 0) {
+                StopVoice(voice);
+            }
+            else if (voice.IsPlaying()) {
+                StartRamp(voice.gain, voice.targetGain, voice.gainStep, voice.rampFrames, 0.0f, command.frames);
+                voice.stopAfterRamp = true;
+            }
+        }
+        break;
+
+    case Command::Type::SetMasterVolume:
+        StartRamp(masterGain, masterTarget, masterStep, masterRampFrames, command.gain, command.frames);
+        break;
+
+    case Command::Type::Pause:
+        paused = true;
+        break;
+
+    case Command::Type::Resume:
+        paused = false;
+        break;
+    }
+}
+
+// Start a voice afresh, releasing what it played
+void AudioMixer::StartVoice(int index, const AudioClip& clip, AudioStream* stream, bool loop, float gain, uint32_t fadeFrames) {
+    Voice& voice = voices[index];
+    StopVoice(voice);
+    voice.clip = clip;
+    voice.stream = stream;
+    voice.position = 0;
+    voice.loop = loop;
+    voice.gain = fadeFrames > 0 ? 0.0f : gain;
+    StartRamp(voice.gain, voice.targetGain, voice.gainStep, voice.rampFrames, gain, fadeFrames);
+    voice.started = ++playCount;
+    if (index < MusicVoice + MusicVoiceCount) {
+        currentMusic = index;
+    }
+}
+
+void AudioMixer::StopVoice(Voice& voice) {
+    if (voice.stream) {
+        voice.stream->MarkReleased(); // Its owner may free it from now on
+    }
+    voice.clip = AudioClip();
+    voice.stream = nullptr;
+    voice.gain = voice.targetGain;
+    voice.rampFrames = 0;
+    voice.stopAfterRamp = false;
+}
+
+// Fill output with frames of mixed sound
+void AudioMixer::Mix(int16_t* output, size_t frames) {
+    const size_t blockFrames = accumulator.size() / Channels;
+    while (frames > 0) {
+        size_t count = std::min(frames, blockFrames);
+        std::fill(accumulator.begin(), accumulator.begin() + count * Channels, 0.0f);
+
+        for (Voice& voice : voices) {
+            if (voice.IsPlaying()) {
+                MixVoice(voice, count);
+            }
+        }
+
+        // The master gain ramps in runs, like a voice's
+        size_t done = 0;
+        while (done < count) {
+            size_t run = count - done;
+            float step = 0.0f;
+            if (masterRampFrames > 0) {
+                run = std::min<size_t>(run, masterRampFrames);
+                step = masterStep;
+            }
+            SaturateSamples(accumulator.data() + done * Channels, output + done * Channels, run, masterGain, step);
+            if (masterRampFrames > 0) {
+                AdvanceRamp(masterGain, masterTarget, masterStep, masterRampFrames, run);
+            }
+            done += run;
+        }
+
+        output += count * Channels;
+        frames -= count;
+    }
+}
+
+// Add a voice's next frames to the start of the accumulator
+void AudioMixer::MixVoice(Voice& voice, size_t frames) {
+    size_t done = 0;
+    while (voice.IsPlaying() && done < frames) {
+        // Up to the end of the block or of the ramp, whichever comes first
+        size_t run = frames - done;
+        float step = 0.0f;
+        if (voice.rampFrames > 0) {
+            run = std::min<size_t>(run, voice.rampFrames);
+            step = voice.gainStep;
+        }
+        bool audible = voice.gain != 0.0f || step != 0.0f;
+        float* sums = accumulator.data() + done * Channels;
+
+        if (voice.stream) {
+            // Read even when silent so that the stream keeps its place. After
+            // an underrun the ramp carries on through the silence.
+            size_t read = voice.stream->Read(streamBlock.data(), run);
+            if (audible) {
+                AccumulateSamples(sums, streamBlock.data(), read, voice.gain, step);
+            }
+            if (read < run && voice.stream->IsFinished()) {
+                StopVoice(voice);
+                break;
+            }
+        }
+        else {
+            // A looping clip carries on from its first frame in the same block
+            run = std::min(run, voice.clip.frames - voice.position);
+            if (audible) {
+                AccumulateSamples(sums, voice.clip.samples + voice.position * Channels, run, voice.gain, step);
+            }
+            voice.position += run;
+            if (voice.position == voice.clip.frames) {
+                voice.position = 0;
+                if (!voice.loop) {
+                    StopVoice(voice);
+                    break;
+                }
+            }
+        }
+        done += run;
+
+        if (voice.rampFrames > 0) {
+            AdvanceRamp(voice.gain, voice.targetGain, voice.gainStep, voice.rampFrames, run);
+            if (voice.rampFrames == 0 && voice.stopAfterRamp) {
+                StopVoice(voice);
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <SDL.h>
+
+class AudioStream;
+
+// A sound in the mixer's format: interleaved signed 16-bit stereo at
+// AudioMixer::SampleRate. The samples belong to whoever loaded the sound,
+// normally the SoundBank.
+struct AudioClip {
+    const int16_t* samples = nullptr;
+    size_t frames = 0;
+};
+
+// Plays a fixed pool of voices on one audio device. SDL calls the mixer
+// from its audio thread whenever the device needs more sound, and the mixer
+// adds up every playing voice straight from its clip or stream, so nothing
+// is queued ahead and a looping voice wraps to its start within the same buffer.
+//
+// The game thread never touches the voices: every call below only queues a
+// command, and the audio thread applies the queued commands at the start of
+// its next buffer. Neither side locks. Volume changes, fades and crossfades
+// ramp the gain linearly, one step per frame. Each call returns false if the
+// queue was full and the command was dropped.
+class AudioMixer {
+public:
+    static const int SampleRate = 44100;
+    static const int Channels = 2;
+    static const int FullVolume = 128;
+
+    // The voice pool. Music plays on one of two voices so that a new track
+    // can fade in on the other while the old one fades out.
+    static const int MusicVoice = 0;
+    static const int MusicVoiceCount = 2;
+    static const int AmbienceVoice = 2;
+    static const int FirstEffectVoice = 3;
+    static const int VoiceCount = 10;
+
+    AudioMixer();
+    ~AudioMixer();
+
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+
+    // Open the default device in the mixer's format and start it
+    bool Open();
+    void Close();
+    bool IsOpen() const { return device != 0; }
+
+    // Start a clip from its beginning on a voice, replacing what it played,
+    // fading in over fadeFrames. Its samples must stay alive until the voice
+    // stops or plays something else.
+    bool Play(int voice, const AudioClip& clip, bool loop, int volume = FullVolume, uint32_t fadeFrames = 0);
+
+    // Play a stream on a voice, replacing what it played. The stream loops
+    // or not as it was opened. The mixer marks it released once it no longer
+    // uses it; until then it must stay alive.
+    bool PlayStream(int voice, AudioStream* stream, int volume = FullVolume, uint32_t fadeFrames = 0);
+
+    // Play a clip once on a free effect voice, or the one that started longest ago
+    bool PlayEffect(const AudioClip& clip, int volume = FullVolume);
+
+    // Fade the current music out and the stream in on the other music voice,
+    // both over frames. A null stream just fades the music out.
+    bool CrossfadeMusic(AudioStream* stream, int volume, uint32_t frames);
+
+    // Ramp a voice's volume (0 to 128) over rampFrames
+    bool SetVolume(int voice, int volume, uint32_t rampFrames = 0);
+
+    // Fade a voice out over fadeFrames and stop it
+    bool Stop(int voice, uint32_t fadeFrames = 0);
+    bool StopAll(uint32_t fadeFrames = 0);
+
+    // Ramp the volume of everything the mixer plays (0 to 128)
+    bool SetMasterVolume(int volume, uint32_t rampFrames = 0);
+
+    // Hold every voice where it is and play silence, or carry on
+    bool Pause(bool paused);
+
+    static uint32_t MillisecondsToFrames(int milliseconds);
+
+private:
+    struct Command {
+        enum class Type { Play, PlayEffect, CrossfadeMusic, SetVolume, Stop, StopAll, SetMasterVolume, Pause, Resume };
+
+        Type type;
+        int voice;
+        AudioClip clip;
+        AudioStream* stream;
+        bool loop;
+        float gain;      // Target gain, 1 for full volume
+        uint32_t frames; // Length of the ramp
+    };
+
+    // Fixed ring of commands from the game thread (the only writer) to the
+    // audio thread (the only reader)
+    class CommandQueue {
+    public:
+        static const size_t Capacity = 256;
+
+        CommandQueue();
+        bool Push(const Command& command); // False if full
+        bool Pop(Command& command);        // False if empty
+
+    private:
+        Command commands[Capacity];
+        alignas(64) std::atomic<size_t> pushed;
+        alignas(64) std::atomic<size_t> popped;
+    };
+
+    struct Voice {
+        AudioClip clip;      // Playing if it has samples
+        AudioStream* stream; // Played instead of clip when set
+        size_t position;     // Next frame of the clip
+        bool loop;
+        float gain;          // At the next frame
+        float targetGain;
+        float gainStep;      // Per frame while ramping
+        uint32_t rampFrames; // Left of the ramp
+        bool stopAfterRamp;  // The ramp is a fade out
+        uint64_t started;    // Orders voices for stealing
+
+        bool IsPlaying() const { return clip.samples || stream; }
+    };
+
+    static void SDLCALL Callback(void* userdata, Uint8* stream, int length);
+
+    // Audio thread: apply everything queued since the last buffer
+    void ApplyCommands();
+    void Apply(const Command& command);
+
+    // Start a voice afresh, releasing what it played
+    void StartVoice(int voice, const AudioClip& clip, AudioStream* stream, bool loop, float gain, uint32_t fadeFrames);
+    void StopVoice(Voice& voice);
+
+    // Fill output with frames of mixed sound
+    void Mix(int16_t* output, size_t frames);
+
+    // Add a voice's next frames to the start of the accumulator
+    void MixVoice(Voice& voice, size_t frames);
+
+    SDL_AudioDeviceID device;
+    CommandQueue commands;
+
+    // Everything below belongs to the audio thread once the device is open
+    Voice voices[VoiceCount];
+    std::vector<float> accumulator;   // One block of samples, sized when the device opens
+    std::vector<int16_t> streamBlock; // A block read from a stream
+    int currentMusic;                 // The music voice that is not fading out
+    float masterGain;
+    float masterTarget;
+    float masterStep;
+    uint32_t masterRampFrames;
+    bool paused;
+    uint64_t playCount;
+};
+
+#endif // AUDIO_MIXER_H
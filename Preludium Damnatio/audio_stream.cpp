@@ -0,0 +1,265 @@
+#include "audio_stream.h"
+#include "audio_mixer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // Ring length: about 1.5 seconds at 44.1 kHz, 256 KB of samples
+    const size_t RingFrames = 65536;
+
+    // Frames of the file read at a time
+    const size_t ChunkFrames = 4096;
+
+    // How often the reader thread tops up the ring; far shorter than the ring lasts
+    const auto RefillInterval = std::chrono::milliseconds(50);
+
+    // The parts of a WAV file's header the stream needs
+    struct WavFormat {
+        SDL_AudioFormat format;
+        int channels;
+        int rate;
+        uint32_t blockSize;
+        std::streamoff dataStart;
+        uint32_t dataSize;
+    };
+
+    uint16_t ReadLittle16(const uint8_t* bytes) {
+        return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+    }
+
+    uint32_t ReadLittle32(const uint8_t* bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    // Walk the RIFF chunks up to the sound data, reading the format on the way.
+    // Handles PCM of 8, 16 or 32 bits and 32-bit float.
+    bool ReadWavFormat(std::istream& file, WavFormat& wav) {
+        uint8_t header[12];
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header))
+            || std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+            return false;
+        }
+
+        bool haveFormat = false;
+        uint16_t tag = 0;
+        uint16_t bits = 0;
+        for (;;) {
+            uint8_t chunkHeader[8];
+            if (!file.read(reinterpret_cast<char*>(chunkHeader), sizeof(chunkHeader))) {
+                return false; // No sound data
+            }
+            uint32_t size = ReadLittle32(chunkHeader + 4);
+
+            if (std::memcmp(chunkHeader, "fmt ", 4) == 0) {
+                if (size < 16 || size > 1024) {
+                    return false;
+                }
+                std::vector<uint8_t> format(size);
+                if (!file.read(reinterpret_cast<char*>(format.data()), size)) {
+                    return false;
+                }
+                tag = ReadLittle16(format.data());
+                wav.channels = ReadLittle16(format.data() + 2);
+                wav.rate = static_cast<int>(ReadLittle32(format.data() + 4));
+                wav.blockSize = ReadLittle16(format.data() + 12);
+                bits = ReadLittle16(format.data() + 14);
+                if (tag == 0xfffe && size >= 26) {
+                    tag = ReadLittle16(format.data() + 24); // Extensible: the sub format starts with the real tag
+                }
+                haveFormat = true;
+            }
+            else if (std::memcmp(chunkHeader, "data", 4) == 0) {
+                if (!haveFormat) {
+                    return false;
+                }
+                wav.dataStart = file.tellg();
+                wav.dataSize = size;
+                break;
+            }
+            else {
+                file.seekg(size, std::ios::cur);
+            }
+            if (size & 1) {
+                file.seekg(1, std::ios::cur); // Chunks are padded to an even length
+            }
+        }
+
+        if (tag == 1 && bits == 8) {
+            wav.format = AUDIO_U8;
+        }
+        else if (tag == 1 && bits == 16) {
+            wav.format = AUDIO_S16LSB;
+        }
+        else if (tag == 1 && bits == 32) {
+            wav.format = AUDIO_S32LSB;
+        }
+        else if (tag == 3 && bits == 32) {
+            wav.format = AUDIO_F32LSB;
+        }
+        else {
+            return false;
+        }
+        if (wav.channels <= 0 || wav.rate <= 0 || wav.blockSize != static_cast<uint32_t>(wav.channels * bits / 8)) {
+            return false;
+        }
+        wav.dataSize -= wav.dataSize % wav.blockSize;
+        return true;
+    }
+}
+
+AudioStream::AudioStream()
+    : dataStart(0),
+    dataSize(0),
+    dataRead(0),
+    blockSize(0),
+    loop(false),
+    fileEnded(false),
+    convertedRead(0),
+    ring(RingFrames * AudioMixer::Channels),
+    stopping(false),
+    ended(false),
+    underruns(0),
+    released(false)
+{
+}
+
+AudioStream::~AudioStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+// Open a WAV file, fill part of the ring and start the reader thread
+bool AudioStream::Open(const std::string& name, bool loops) {
+    if (thread.joinable()) {
+        return false; // Already open
+    }
+
+    filename = name;
+    loop = loops;
+    file.open(filename, std::ios::in | std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open audio: " << filename << std::endl;
+        return false;
+    }
+
+    WavFormat wav;
+    if (!ReadWavFormat(file, wav)) {
+        std::cerr << "Not a supported WAV file: " << filename << std::endl;
+        return false;
+    }
+    if (!converter.Start(wav.format, wav.channels, wav.rate)) {
+        std::cerr << "Unsupported audio format: " << filename << std::endl;
+        return false;
+    }
+
+    dataStart = wav.dataStart;
+    dataSize = wav.dataSize;
+    blockSize = wav.blockSize;
+    chunk.resize(ChunkFrames * blockSize);
+    converted.reserve((ChunkFrames * AudioMixer::SampleRate / wav.rate + ChunkFrames) * AudioMixer::Channels);
+
+    Fill();
+    thread = std::thread(&AudioStream::Run, this);
+    return true;
+}
+
+// Audio callback: copy up to frames of sound into output
+size_t AudioStream::Read(int16_t* output, size_t frames) {
+    // Checked first: once set, everything left is already in the ring
+    bool lastSamples = ended.load(std::memory_order_acquire);
+    size_t count = ring.Read(output, frames * AudioMixer::Channels) / AudioMixer::Channels;
+    if (count < frames && !lastSamples) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+// Everything has been read out of a stream that does not loop
+bool AudioStream::IsFinished() const {
+    return ended.load(std::memory_order_acquire) && ring.GetAvailable() == 0;
+}
+
+uint64_t AudioStream::GetUnderrunCount() const {
+    return underruns.load(std::memory_order_relaxed);
+}
+
+// Audio thread: the mixer has stopped playing the stream
+void AudioStream::MarkReleased() {
+    released.store(true, std::memory_order_release);
+}
+
+bool AudioStream::IsReleased() const {
+    return released.load(std::memory_order_acquire);
+}
+
+void AudioStream::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        lock.unlock();
+        Fill();
+        lock.lock();
+        wake.wait_for(lock, RefillInterval, [this] { return stopping; });
+    }
+}
+
+// Decode and convert into the ring until it is full or the file ends
+void AudioStream::Fill() {
+    while (!ended.load(std::memory_order_relaxed)) {
+        // Hand over the converted chunk as far as it fits
+        if (convertedRead < converted.size()) {
+            size_t written = ring.Write(converted.data() + convertedRead, converted.size() - convertedRead);
+            if (written == 0) {
+                return; // Full
+            }
+            convertedRead += written;
+            continue;
+        }
+
+        converted.clear();
+        convertedRead = 0;
+        if (fileEnded) {
+            ended.store(true, std::memory_order_release);
+            return;
+        }
+        if (!ReadChunk()) {
+            fileEnded = true;
+            converter.Finish(converted); // What the resampler held back
+        }
+    }
+}
+
+// Read and convert the next chunk of the file
+bool AudioStream::ReadChunk() {
+    if (dataRead == dataSize) {
+        if (!loop || dataSize == 0) {
+            return false;
+        }
+        // Back to the first frame; the converter carries on as if the sound were continuous,
+        // so the loop point is filtered like any other
+        file.clear();
+        file.seekg(dataStart);
+        dataRead = 0;
+    }
+
+    uint32_t bytes = std::min(static_cast<uint32_t>(chunk.size()), dataSize - dataRead);
+    file.read(reinterpret_cast<char*>(chunk.data()), bytes);
+    uint32_t got = static_cast<uint32_t>(file.gcount());
+    got -= got % blockSize;
+    if (got < bytes) {
+        dataSize = dataRead + got; // The file is shorter than its header says
+    }
+    if (got == 0) {
+        return false;
+    }
+    dataRead += got;
+    converter.Convert(chunk.data(), got, converted);
+    return true;
+}
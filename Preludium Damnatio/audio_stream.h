@@ -0,0 +1,80 @@
+#ifndef AUDIO_STREAM_H
+#define AUDIO_STREAM_H
+
+#include "audio_convert.h"
+#include "sample_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Plays a long WAV track (music, ambience) without loading it: a reader
+// thread decodes it from disk a chunk at a time, converts it to the mixer's
+// format and keeps a ring of about a second and a half filled ahead of the
+// audio callback. Memory use is a few hundred KB whatever the track's length.
+class AudioStream {
+public:
+    AudioStream();
+    ~AudioStream(); // Stops the reader thread
+
+    AudioStream(const AudioStream&) = delete;
+    AudioStream& operator=(const AudioStream&) = delete;
+
+    // Open a WAV file and start reading it. Part of the ring is filled before
+    // returning, so playback can start at once. A looping stream goes back to
+    // the start of the sound when it reaches the end, with no gap.
+    bool Open(const std::string& filename, bool loop);
+
+    // Audio callback: copy up to frames of sound into output and return how
+    // many were copied. Coming up short before the end counts an underrun.
+    size_t Read(int16_t* output, size_t frames);
+
+    // Everything has been read out of a stream that does not loop
+    bool IsFinished() const;
+
+    // Callbacks that found the ring empty before the end of the track
+    uint64_t GetUnderrunCount() const;
+
+    // Audio thread: the mixer has stopped playing the stream, so its owner
+    // may destroy it
+    void MarkReleased();
+    bool IsReleased() const;
+
+private:
+    void Run();
+
+    // Decode and convert into the ring until it is full or the file ends
+    void Fill();
+
+    // Read and convert the next chunk of the file; false at the end or on an error
+    bool ReadChunk();
+
+    std::string filename;
+    std::ifstream file;
+    AudioConverter converter;   // From the file's format to the mixer's
+    std::streamoff dataStart;   // The sound data in the file
+    uint32_t dataSize;
+    uint32_t dataRead;
+    uint32_t blockSize;         // Bytes per frame in the file
+    bool loop;
+    bool fileEnded;             // Everything has been converted; only the reader thread uses this
+    std::vector<uint8_t> chunk;
+    std::vector<int16_t> converted; // A converted chunk on its way into the ring
+    size_t convertedRead;
+    SampleRing ring;
+
+    std::mutex mutex;
+    std::condition_variable wake; // Signals the thread to stop
+    bool stopping;
+    std::thread thread;
+
+    std::atomic<bool> ended;      // The last samples are in the ring
+    std::atomic<uint64_t> underruns;
+    std::atomic<bool> released;
+};
+
+#endif // AUDIO_STREAM_H
@@ -0,0 +1,28 @@
+#include "autoplay_driver.h"
+
+AutoplayDriver::AutoplayDriver(StoryManager& storyManager, ChoicePolicy& policy)
+    : storyManager(storyManager),
+    policy(policy)
+{
+}
+
+// Make one choice; returns false once the game is over
+bool AutoplayDriver::PlayTurn() {
+    if (storyManager.IsGameOver()) {
+        return false;
+    }
+
+    int choice = policy.ChooseOption(storyManager.GetCurrentOptionCount());
+    storyManager.HandleChoice(choice);
+    return !storyManager.IsGameOver();
+}
+
+// Play until the game is over or maxTurns choices were made
+int AutoplayDriver::PlayGame(int maxTurns) {
+    int turns = 0;
+    while (turns < maxTurns && !storyManager.IsGameOver()) {
+        PlayTurn();
+        ++turns;
+    }
+    return turns;
+}
@@ -0,0 +1,24 @@
+#ifndef AUTOPLAY_DRIVER_H
+#define AUTOPLAY_DRIVER_H
+
+#include "story_manager.h"
+#include "choice_policy.h"
+
+// Plays a story without a player: each turn asks the policy for a choice
+// and applies it to the StoryManager, the same way the main loop does.
+class AutoplayDriver {
+public:
+    AutoplayDriver(StoryManager& storyManager, ChoicePolicy& policy);
+
+    // Make one choice; returns false once the game is over
+    bool PlayTurn();
+
+    // Play until the game is over or maxTurns choices were made; returns the turns played
+    int PlayGame(int maxTurns);
+
+private:
+    StoryManager& storyManager;
+    ChoicePolicy& policy;
+};
+
+#endif // AUTOPLAY_DRIVER_H
@@ -0,0 +1,97 @@
+#include "autosave_writer.h"
+#include "save_file.h"
+
+AutosaveWriter::AutosaveWriter(const std::string& filename)
+    : filename(filename),
+    request(Request::None),
+    busy(false),
+    stopping(false),
+    writeCount(0),
+    failureCount(0)
+{
+    thread = std::thread(&AutosaveWriter::Run, this);
+}
+
+AutosaveWriter::~AutosaveWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+// Queue a snapshot, replacing any that has not been picked up yet
+void AutosaveWriter::Submit(std::vector<uint8_t>& snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(snapshot);
+        request = Request::Write;
+    }
+    wake.notify_one();
+}
+
+// Queue removal of the autosave, dropping any pending snapshot
+void AutosaveWriter::Remove() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request = Request::Remove;
+    }
+    wake.notify_one();
+}
+
+// Wait until the thread has nothing queued and is not writing
+void AutosaveWriter::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return request == Request::None && !busy; });
+}
+
+const std::string& AutosaveWriter::GetFilename() const {
+    return filename;
+}
+
+uint64_t AutosaveWriter::GetWriteCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeCount;
+}
+
+uint64_t AutosaveWriter::GetFailureCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failureCount;
+}
+
+void AutosaveWriter::Run() {
+    std::vector<uint8_t> writing; // Snapshot being written, outside the lock
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return request != Request::None || stopping; });
+        if (request == Request::None) {
+            break; // Stopping with nothing left to write
+        }
+
+        Request current = request;
+        request = Request::None;
+        if (current == Request::Write) {
+            writing.swap(pending);
+        }
+        busy = true;
+        lock.unlock();
+
+        bool succeeded = current == Request::Write
+            ? WriteFileAtomically(filename, writing.data(), writing.size())
+            : RemoveFile(filename);
+
+        lock.lock();
+        busy = false;
+        if (!succeeded) {
+            ++failureCount;
+        }
+        else if (current == Request::Write) {
+            ++writeCount;
+        }
+        if (request == Request::None) {
+            done.notify_all();
+        }
+    }
+    done.notify_all();
+}
@@ -0,0 +1,60 @@
+#ifndef AUTOSAVE_WRITER_H
+#define AUTOSAVE_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes autosaves from a background thread so the game loop never waits on
+// the disk. Only the newest submitted snapshot matters: if the thread is
+// still busy when another one arrives, the older pending one is replaced.
+// Snapshot buffers are swapped rather than copied, so saving every turn
+// settles into no allocations once the buffers have grown.
+class AutosaveWriter {
+public:
+    explicit AutosaveWriter(const std::string& filename);
+    ~AutosaveWriter(); // Finishes any pending write before returning
+
+    AutosaveWriter(const AutosaveWriter&) = delete;
+    AutosaveWriter& operator=(const AutosaveWriter&) = delete;
+
+    // Queue a snapshot to be written. The caller gets an old buffer back in
+    // snapshot, ready to be reused for the next one.
+    void Submit(std::vector<uint8_t>& snapshot);
+
+    // Queue removal of the autosave (e.g. once the game has ended)
+    void Remove();
+
+    // Block until everything queued so far has reached the disk
+    void Flush();
+
+    const std::string& GetFilename() const;
+    uint64_t GetWriteCount() const;   // Snapshots written
+    uint64_t GetFailureCount() const; // Writes or removals that failed
+
+private:
+    enum class Request {
+        None,
+        Write,
+        Remove
+    };
+
+    void Run();
+
+    std::string filename;
+    mutable std::mutex mutex;
+    std::condition_variable wake; // Signals the thread that there is work or it should stop
+    std::condition_variable done; // Signals Flush that the thread went idle
+    std::vector<uint8_t> pending; // Newest snapshot not yet picked up by the thread
+    Request request;
+    bool busy;     // The thread is writing outside the lock
+    bool stopping;
+    uint64_t writeCount;
+    uint64_t failureCount;
+    std::thread thread;
+};
+
+#endif // AUTOSAVE_WRITER_H
@@ -0,0 +1,63 @@
+#include "choice_policy.h"
+#include <sstream>
+
+RandomChoicePolicy::RandomChoicePolicy(unsigned int seed) : generator(seed) {}
+
+int RandomChoicePolicy::ChooseOption(int optionsCount) {
+    if (optionsCount < 1) {
+        return 1;
+    }
+    std::uniform_int_distribution<int> distribution(1, optionsCount);
+    return distribution(generator);
+}
+
+ScriptedChoicePolicy::ScriptedChoicePolicy(const std::vector<int>& choices) : choices(choices), nextChoice(0) {}
+
+int ScriptedChoicePolicy::ChooseOption(int optionsCount) {
+    if (choices.empty() || optionsCount < 1) {
+        return 1;
+    }
+    int choice = choices[nextChoice];
+    nextChoice = (nextChoice + 1) % choices.size();
+    return choice < 1 ? 1 : (choice - 1) % optionsCount + 1;
+}
+
+RoundRobinChoicePolicy::RoundRobinChoicePolicy() : turn(0) {}
+
+int RoundRobinChoicePolicy::ChooseOption(int optionsCount) {
+    if (optionsCount < 1) {
+        return 1;
+    }
+    return static_cast<int>(turn++ % static_cast<unsigned int>(optionsCount)) + 1;
+}
+
+// Create a policy from a command-line style description
+std::unique_ptr<ChoicePolicy> CreateChoicePolicy(const std::string& description, unsigned int seed) {
+    if (description == "random") {
+        return std::unique_ptr<ChoicePolicy>(new RandomChoicePolicy(seed));
+    }
+    if (description == "roundrobin") {
+        return std::unique_ptr<ChoicePolicy>(new RoundRobinChoicePolicy());
+    }
+
+    const std::string scriptedPrefix = "scripted:";
+    if (description.compare(0, scriptedPrefix.size(), scriptedPrefix) == 0) {
+        std::vector<int> choices;
+        std::istringstream script(description.substr(scriptedPrefix.size()));
+        std::string choice;
+        while (std::getline(script, choice, ',')) {
+            try {
+                choices.push_back(std::stoi(choice));
+            }
+            catch (const std::exception&) {
+                return nullptr; // Not a number
+            }
+        }
+        if (choices.empty()) {
+            return nullptr;
+        }
+        return std::unique_ptr<ChoicePolicy>(new ScriptedChoicePolicy(choices));
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,54 @@
+#ifndef CHOICE_POLICY_H
+#define CHOICE_POLICY_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Picks options on behalf of the player when the game runs without input
+class ChoicePolicy {
+public:
+    virtual ~ChoicePolicy() = default;
+
+    // Return a choice between 1 and optionsCount, like InputManager::GetPlayerChoice
+    virtual int ChooseOption(int optionsCount) = 0;
+};
+
+// Uniformly random choices from a seeded generator, so runs can be repeated
+class RandomChoicePolicy : public ChoicePolicy {
+public:
+    explicit RandomChoicePolicy(unsigned int seed);
+    int ChooseOption(int optionsCount) override;
+
+private:
+    std::mt19937 generator;
+};
+
+// Plays back a fixed list of choices, starting over when it runs out.
+// Choices larger than the number of options wrap around.
+class ScriptedChoicePolicy : public ChoicePolicy {
+public:
+    explicit ScriptedChoicePolicy(const std::vector<int>& choices);
+    int ChooseOption(int optionsCount) override;
+
+private:
+    std::vector<int> choices;
+    size_t nextChoice;
+};
+
+// Takes option 1, then 2, then 3, ... on successive turns, wrapping at each node's option count
+class RoundRobinChoicePolicy : public ChoicePolicy {
+public:
+    RoundRobinChoicePolicy();
+    int ChooseOption(int optionsCount) override;
+
+private:
+    unsigned int turn;
+};
+
+// Create a policy from a command-line style description:
+// "random", "roundrobin" or "scripted:1,2,3". Returns nullptr if it is not recognised.
+std::unique_ptr<ChoicePolicy> CreateChoicePolicy(const std::string& description, unsigned int seed);
+
+#endif // CHOICE_POLICY_H
@@ -0,0 +1,132 @@
+#include "encounter_table.h"
+
+namespace {
+    // Alias picks to try before falling back to a scan of what is left in the bag
+    const int MaxRejectedDraws = 8;
+
+    bool IsDrawn(const EncounterBag& bag, int encounter) {
+        return (bag.drawn[encounter >> 6] >> (encounter & 63)) & 1;
+    }
+}
+
+// Start over with an empty bag
+void EncounterBag::Reset(int encounterCount) {
+    drawn.assign((encounterCount + 63) / 64, 0);
+    drawnCount = 0;
+    lastEncounter = -1;
+}
+
+// Collect the encounter nodes of a graph and build the alias table
+void EncounterTable::Build(const StoryGraph& graph) {
+    nodes.clear();
+    weights.clear();
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (graph.IsDefined(node) && graph.GetEncounterWeight(node) > 0) {
+            nodes.push_back(node);
+            weights.push_back(graph.GetEncounterWeight(node));
+        }
+    }
+
+    // Vose's method: scale weights so the mean is 1, then pair each column
+    // below 1 with one above 1 that fills the rest of it
+    size_t count = nodes.size();
+    double total = 0;
+    for (uint32_t weight : weights) {
+        total += weight;
+    }
+    std::vector<double> scaled(count);
+    std::vector<int> small;
+    std::vector<int> large;
+    for (size_t i = 0; i < count; ++i) {
+        scaled[i] = weights[i] * count / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<int>(i));
+    }
+
+    const double FullColumn = 4294967296.0; // 2^32
+    threshold.assign(count, static_cast<uint64_t>(FullColumn));
+    alias.assign(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        alias[i] = static_cast<int>(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        int less = small.back();
+        small.pop_back();
+        int more = large.back();
+        threshold[less] = static_cast<uint64_t>(scaled[less] * FullColumn);
+        alias[less] = more;
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // Whatever is left is 1 up to rounding error and keeps its full column
+}
+
+int EncounterTable::GetCount() const {
+    return static_cast<int>(nodes.size());
+}
+
+int EncounterTable::GetNode(int encounter) const {
+    return nodes[encounter];
+}
+
+// High 32 bits pick the column, low 32 bits decide between it and its alias
+int EncounterTable::Sample(RandomGenerator& random) const {
+    uint64_t bits = random.Next();
+    int column = static_cast<int>(((bits >> 32) * nodes.size()) >> 32);
+    return (bits & 0xFFFFFFFFu) < threshold[column] ? column : alias[column];
+}
+
+// Pick an encounter the bag has not handed out this round
+int EncounterTable::Draw(EncounterBag& bag, RandomGenerator& random) const {
+    int count = GetCount();
+    if (count == 0) {
+        return StoryGraph::InvalidNode;
+    }
+    if (bag.drawn.size() != static_cast<size_t>((count + 63) / 64)) {
+        bag.Reset(count);
+    }
+    if (bag.drawnCount >= count) {
+        int last = bag.lastEncounter;
+        bag.Reset(count);
+        bag.lastEncounter = last;
+    }
+
+    // The last encounter of a round may not open the next one (unless it is the only one)
+    int excluded = bag.drawnCount == 0 && count > 1 ? bag.lastEncounter : -1;
+
+    int encounter = -1;
+    for (int attempt = 0; attempt < MaxRejectedDraws && encounter < 0; ++attempt) {
+        int candidate = Sample(random);
+        if (!IsDrawn(bag, candidate) && candidate != excluded) {
+            encounter = candidate;
+        }
+    }
+
+    // Late in a round most picks are rejected, so choose among the rest directly
+    if (encounter < 0) {
+        uint64_t remaining = 0;
+        for (int i = 0; i < count; ++i) {
+            if (!IsDrawn(bag, i) && i != excluded) {
+                remaining += weights[i];
+            }
+        }
+        uint64_t target = random.Next() % remaining;
+        for (int i = 0; i < count; ++i) {
+            if (IsDrawn(bag, i) || i == excluded) {
+                continue;
+            }
+            if (target < weights[i]) {
+                encounter = i;
+                break;
+            }
+            target -= weights[i];
+        }
+    }
+
+    bag.drawn[encounter >> 6] |= uint64_t(1) << (encounter & 63);
+    ++bag.drawnCount;
+    bag.lastEncounter = encounter;
+    return nodes[encounter];
+}
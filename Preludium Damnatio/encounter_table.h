@@ -0,0 +1,46 @@
+#ifndef ENCOUNTER_TABLE_H
+#define ENCOUNTER_TABLE_H
+
+#include "story_graph.h"
+#include "random_generator.h"
+#include <cstdint>
+#include <vector>
+
+// Per-session shuffle-bag state: every encounter is handed out once per
+// round before any of them comes up again
+struct EncounterBag {
+    std::vector<uint64_t> drawn; // One bit per encounter drawn this round
+    int drawnCount = 0;
+    int lastEncounter = -1;      // Encounter drawn most recently (never first in the next round)
+
+    // Start over with an empty bag for a table of encounterCount encounters
+    void Reset(int encounterCount);
+};
+
+// The random encounter nodes of a story (nodes with an "encounter <weight>"
+// line). Weighted picks use Vose's alias table, so each pick costs one random
+// number and two table reads however many encounters there are. The table is
+// built once per story and only read afterwards, so sessions can share it.
+class EncounterTable {
+public:
+    // Collect the encounter nodes of a graph and build the alias table
+    void Build(const StoryGraph& graph);
+
+    int GetCount() const;
+    int GetNode(int encounter) const;
+
+    // Pick an encounter with probability proportional to its weight
+    int Sample(RandomGenerator& random) const;
+
+    // Pick an encounter the bag has not handed out this round and return its
+    // node (StoryGraph::InvalidNode if the story has no encounters)
+    int Draw(EncounterBag& bag, RandomGenerator& random) const;
+
+private:
+    std::vector<int> nodes;          // Encounter -> node index
+    std::vector<uint32_t> weights;
+    std::vector<uint64_t> threshold; // Keep the picked column if 32 random bits are below this (2^32 = always)
+    std::vector<int> alias;          // Encounter to use otherwise
+};
+
+#endif // ENCOUNTER_TABLE_H
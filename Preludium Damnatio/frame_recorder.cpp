@@ -0,0 +1,158 @@
+#include "frame_recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    // frame_0001.bmp and so on, in the order frames were drawn
+    std::string FrameFileName(size_t frame) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%04zu.bmp", frame);
+        return name;
+    }
+
+    std::string JoinPath(const std::string& directory, const std::string& file) {
+        if (directory.empty() || directory.back() == '/' || directory.back() == '\\') {
+            return directory + file;
+        }
+        return directory + "/" + file;
+    }
+
+    // Mean, median, 95th percentile and maximum of one timing
+    void PrintTiming(std::ostream& out, const char* name, std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double value : values) {
+            sum += value;
+        }
+        size_t count = values.size();
+        out << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << sum / count
+            << std::setw(10) << values[count / 2]
+            << std::setw(10) << values[std::min(count - 1, count * 95 / 100)]
+            << std::setw(10) << values.back() << std::endl;
+    }
+}
+
+FrameRecorder::FrameRecorder(const std::string& dumpDirectory, const std::string& goldenDirectory)
+    : dumpDirectory(dumpDirectory),
+    goldenDirectory(goldenDirectory),
+    channelTolerance(0),
+    allowedPixels(0),
+    mismatches(0)
+{
+}
+
+// Allow small differences from the golden images
+void FrameRecorder::SetTolerance(int tolerance, long long pixels) {
+    channelTolerance = std::max(tolerance, 0);
+    allowedPixels = std::max(pixels, 0LL);
+}
+
+// Record one finished frame
+void FrameRecorder::AddFrame(SDL_Surface* frame, const FrameTimings& frameTimings) {
+    timings.push_back(frameTimings);
+    std::string fileName = FrameFileName(timings.size());
+
+    if (!dumpDirectory.empty()) {
+        std::string dumpFile = JoinPath(dumpDirectory, fileName);
+        if (SDL_SaveBMP(frame, dumpFile.c_str()) != 0) {
+            std::cerr << "Failed to write frame: " << dumpFile << " " << SDL_GetError() << std::endl;
+        }
+    }
+
+    if (!goldenDirectory.empty()) {
+        std::string goldenFile = JoinPath(goldenDirectory, fileName);
+        long long differences = CompareWithGolden(frame, goldenFile);
+        if (differences < 0 || differences > allowedPixels) {
+            ++mismatches;
+            if (differences < 0) {
+                std::cerr << "No golden image to compare with: " << goldenFile << std::endl;
+            }
+            else {
+                std::cerr << "Frame " << timings.size() << " differs from " << goldenFile
+                    << " in " << differences << " pixels" << std::endl;
+            }
+        }
+    }
+}
+
+// Timing percentiles of every frame, and the golden comparison results
+void FrameRecorder::PrintReport(std::ostream& out) const {
+    out << "Frames: " << timings.size() << std::endl;
+    if (timings.empty()) {
+        return;
+    }
+
+    std::vector<double> text, images, present, total;
+    for (const FrameTimings& frame : timings) {
+        text.push_back(frame.text);
+        images.push_back(frame.images);
+        present.push_back(frame.present);
+        total.push_back(frame.total);
+    }
+    out << "CPU time (us)  mean       p50       p95       max" << std::endl;
+    PrintTiming(out, "text", text);
+    PrintTiming(out, "images", images);
+    PrintTiming(out, "present", present);
+    PrintTiming(out, "total", total);
+
+    if (!goldenDirectory.empty()) {
+        out << "Golden images: " << mismatches << " of " << timings.size() << " frames differ";
+        if (channelTolerance > 0 || allowedPixels > 0) {
+            out << " (tolerance " << channelTolerance << " per channel, " << allowedPixels << " pixels)";
+        }
+        out << std::endl;
+    }
+}
+
+int FrameRecorder::GetMismatchCount() const {
+    return mismatches;
+}
+
+// Number of pixels that differ from the golden image beyond the channel tolerance, or -1 if it cannot be read
+long long FrameRecorder::CompareWithGolden(SDL_Surface* frame, const std::string& goldenFile) const {
+    SDL_Surface* loaded = SDL_LoadBMP(goldenFile.c_str());
+    if (loaded == nullptr) {
+        return -1;
+    }
+
+    // Compare in the frame's own pixel format
+    SDL_Surface* golden = SDL_ConvertSurfaceFormat(loaded, frame->format->format, 0);
+    SDL_FreeSurface(loaded);
+    if (golden == nullptr) {
+        return -1;
+    }
+    if (golden->w != frame->w || golden->h != frame->h) {
+        long long pixels = static_cast<long long>(frame->w) * frame->h;
+        SDL_FreeSurface(golden);
+        return pixels; // A different size counts as every pixel differing
+    }
+
+    // Rows that match byte for byte are skipped; the rest are compared pixel by pixel
+    long long differences = 0;
+    int bytesPerPixel = frame->format->BytesPerPixel;
+    size_t rowBytes = static_cast<size_t>(frame->w) * bytesPerPixel;
+    for (int y = 0; y < frame->h; ++y) {
+        const uint8_t* frameRow = static_cast<const uint8_t*>(frame->pixels) + static_cast<size_t>(y) * frame->pitch;
+        const uint8_t* goldenRow = static_cast<const uint8_t*>(golden->pixels) + static_cast<size_t>(y) * golden->pitch;
+        if (std::memcmp(frameRow, goldenRow, rowBytes) == 0) {
+            continue;
+        }
+        for (int x = 0; x < frame->w; ++x) {
+            const uint8_t* framePixel = frameRow + x * bytesPerPixel;
+            const uint8_t* goldenPixel = goldenRow + x * bytesPerPixel;
+            for (int channel = 0; channel < bytesPerPixel; ++channel) {
+                if (std::abs(framePixel[channel] - goldenPixel[channel]) > channelTolerance) {
+                    ++differences;
+                    break;
+                }
+            }
+        }
+    }
+    SDL_FreeSurface(golden);
+    return differences;
+}
@@ -0,0 +1,49 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include "render_manager.h"
+#include <ostream>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+// Collects the timings of frames drawn offscreen and, if given directories,
+// writes each frame as frame_NNNN.bmp and compares it pixel for pixel with
+// the file of the same name in the golden directory. Used by --offscreen to
+// get repeatable rendering numbers and catch rendering regressions without
+// a display. Font rasterizers differ slightly between FreeType and SDL
+// versions, so the comparison can allow small channel differences and a
+// number of differing pixels.
+class FrameRecorder {
+public:
+    // Either directory may be empty to skip dumping or comparing
+    FrameRecorder(const std::string& dumpDirectory, const std::string& goldenDirectory);
+
+    // A pixel differs only if one of its channels is off by more than
+    // channelTolerance; a frame matches if at most allowedPixels differ.
+    // Both are 0 (exact match) by default.
+    void SetTolerance(int channelTolerance, long long allowedPixels);
+
+    // Record one finished frame (frame holds its pixels)
+    void AddFrame(SDL_Surface* frame, const FrameTimings& timings);
+
+    // Timing percentiles of every frame, and the golden comparison results
+    void PrintReport(std::ostream& out) const;
+
+    // Frames that differ from their golden image (or have none)
+    int GetMismatchCount() const;
+
+private:
+    // Number of pixels that differ from the golden image beyond the channel
+    // tolerance, or -1 if it cannot be read
+    long long CompareWithGolden(SDL_Surface* frame, const std::string& goldenFile) const;
+
+    std::string dumpDirectory;
+    std::string goldenDirectory;
+    std::vector<FrameTimings> timings;
+    int channelTolerance;
+    long long allowedPixels;
+    int mismatches;
+};
+
+#endif // FRAME_RECORDER_H
@@ -0,0 +1,308 @@
+#include "glyph_atlas.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    const int AtlasWidth = 512;
+    const int InitialAtlasHeight = 128;
+    const int MaxAtlasHeight = 4096;
+    const int GlyphPadding = 1; // Empty pixels between glyphs, so filtering never samples a neighbour
+
+    // Texture holding a copy of the atlas pixels. Its format is fixed, so
+    // SDL_UpdateTexture can take rows of the ARGB8888 surface as they are.
+    SDL_Texture* CreateTexture(SDL_Renderer* renderer, SDL_Surface* pixels) {
+        SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, pixels->w, pixels->h);
+        if (texture == nullptr) {
+            return nullptr;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        SDL_UpdateTexture(texture, nullptr, pixels->pixels, pixels->pitch);
+        return texture;
+    }
+}
+
+GlyphAtlas::GlyphAtlas()
+    : renderer(nullptr),
+    font(nullptr),
+    pixels(nullptr),
+    texture(nullptr),
+    shelfX(0),
+    shelfY(0),
+    shelfHeight(0),
+    kerning(false),
+    glyphs()
+{
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    Release();
+}
+
+// Start a new atlas for a font
+bool GlyphAtlas::Build(SDL_Renderer* newRenderer, TTF_Font* newFont) {
+    Release();
+    renderer = newRenderer;
+    font = newFont;
+    kerning = TTF_GetFontKerning(font) != 0;
+
+    pixels = SDL_CreateRGBSurfaceWithFormat(0, AtlasWidth, InitialAtlasHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (pixels == nullptr) {
+        std::cerr << "Failed to create glyph atlas: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_FillRect(pixels, nullptr, 0);
+    texture = CreateTexture(renderer, pixels);
+    if (texture == nullptr) {
+        std::cerr << "Failed to create glyph atlas texture: " << SDL_GetError() << std::endl;
+        Release();
+        return false;
+    }
+
+    // Everything the story text uses today
+    for (int ch = ' '; ch <= '~'; ++ch) {
+        LoadGlyph(static_cast<unsigned char>(ch));
+    }
+    return true;
+}
+
+// Free the texture; call before the renderer is destroyed
+void GlyphAtlas::Release() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
+    if (pixels) {
+        SDL_FreeSurface(pixels);
+        pixels = nullptr;
+    }
+    for (AtlasGlyph& glyph : glyphs) {
+        glyph = AtlasGlyph();
+    }
+    shelfX = 0;
+    shelfY = 0;
+    shelfHeight = 0;
+    font = nullptr;
+    Discard();
+}
+
+// Upload the atlas again from its CPU copy
+bool GlyphAtlas::RecreateTexture() {
+    if (pixels == nullptr) {
+        return false; // Never built
+    }
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+    texture = CreateTexture(renderer, pixels);
+    if (texture == nullptr) {
+        std::cerr << "Failed to recreate glyph atlas texture: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Queue a line of text with its top left corner at (x, y)
+int GlyphAtlas::AddText(std::string_view text, int x, int y, SDL_Color color) {
+    return BuildText(text, x, y, color, vertices, indices);
+}
+
+// Width of a line of text as AddText would draw it
+int GlyphAtlas::MeasureText(std::string_view text) {
+    if (texture == nullptr) {
+        return 0;
+    }
+
+    int width = 0;
+    unsigned char previous = 0;
+    for (char c : text) {
+        unsigned char ch = static_cast<unsigned char>(c);
+        if (kerning && previous != 0) {
+            width += TTF_GetFontKerningSizeGlyphs32(font, previous, ch);
+        }
+        previous = ch;
+        width += GetGlyph(ch).advance;
+    }
+    return width;
+}
+
+// Build the quads for a line of text into the given arrays
+int GlyphAtlas::BuildText(std::string_view text, int x, int y, SDL_Color color,
+    std::vector<SDL_Vertex>& outVertices, std::vector<int>& outIndices) {
+    if (texture == nullptr) {
+        return 0;
+    }
+
+    int penX = x;
+    unsigned char previous = 0;
+    for (char c : text) {
+        unsigned char ch = static_cast<unsigned char>(c);
+        if (kerning && previous != 0) {
+            penX += TTF_GetFontKerningSizeGlyphs32(font, previous, ch);
+        }
+        previous = ch;
+
+        const AtlasGlyph& glyph = GetGlyph(ch);
+        if (glyph.source.w > 0) {
+            // Two triangles per glyph; texture coordinates stay in pixels until Flush
+            float left = static_cast<float>(penX + glyph.offsetX);
+            float top = static_cast<float>(y);
+            float right = left + glyph.source.w;
+            float bottom = top + glyph.source.h;
+            float u0 = static_cast<float>(glyph.source.x);
+            float v0 = static_cast<float>(glyph.source.y);
+            float u1 = u0 + glyph.source.w;
+            float v1 = v0 + glyph.source.h;
+
+            int first = static_cast<int>(outVertices.size());
+            outVertices.push_back({ { left, top }, color, { u0, v0 } });
+            outVertices.push_back({ { right, top }, color, { u1, v0 } });
+            outVertices.push_back({ { right, bottom }, color, { u1, v1 } });
+            outVertices.push_back({ { left, bottom }, color, { u0, v1 } });
+            outIndices.push_back(first);
+            outIndices.push_back(first + 1);
+            outIndices.push_back(first + 2);
+            outIndices.push_back(first);
+            outIndices.push_back(first + 2);
+            outIndices.push_back(first + 3);
+        }
+        penX += glyph.advance;
+    }
+    return penX - x;
+}
+
+// Queue quads made by BuildText, moved by (x, y)
+void GlyphAtlas::AddGeometry(const std::vector<SDL_Vertex>& geometryVertices, const std::vector<int>& geometryIndices, int x, int y) {
+    if (texture == nullptr) {
+        return;
+    }
+    int first = static_cast<int>(vertices.size());
+    float offsetX = static_cast<float>(x);
+    float offsetY = static_cast<float>(y);
+    for (SDL_Vertex vertex : geometryVertices) {
+        vertex.position.x += offsetX;
+        vertex.position.y += offsetY;
+        vertices.push_back(vertex);
+    }
+    for (int index : geometryIndices) {
+        indices.push_back(first + index);
+    }
+}
+
+// Draw and clear everything queued
+void GlyphAtlas::Flush() {
+    if (indices.empty()) {
+        return;
+    }
+
+    // The atlas may have grown since the text was queued, so normalise now
+    float scaleU = 1.0f / pixels->w;
+    float scaleV = 1.0f / pixels->h;
+    for (SDL_Vertex& vertex : vertices) {
+        vertex.tex_coord.x *= scaleU;
+        vertex.tex_coord.y *= scaleV;
+    }
+    SDL_RenderGeometry(renderer, texture, vertices.data(), static_cast<int>(vertices.size()),
+        indices.data(), static_cast<int>(indices.size()));
+    Discard();
+}
+
+// Clear everything queued without drawing it
+void GlyphAtlas::Discard() {
+    vertices.clear();
+    indices.clear();
+}
+
+const AtlasGlyph& GlyphAtlas::GetGlyph(unsigned char ch) {
+    if (!glyphs[ch].loaded) {
+        LoadGlyph(ch);
+    }
+    return glyphs[ch];
+}
+
+// Rasterize one glyph in white and copy it into the atlas
+void GlyphAtlas::LoadGlyph(unsigned char ch) {
+    AtlasGlyph& glyph = glyphs[ch];
+    glyph = AtlasGlyph();
+    glyph.loaded = true; // Even on failure, so a missing glyph is not retried every frame
+
+    int minX = 0;
+    int maxX = 0;
+    int minY = 0;
+    int maxY = 0;
+    if (TTF_GlyphMetrics32(font, ch, &minX, &maxX, &minY, &maxY, &glyph.advance) != 0) {
+        return;
+    }
+    // The bitmap is a one-glyph line: font height tall, starting left of the pen if the glyph overhangs
+    glyph.offsetX = std::min(minX, 0);
+    if (maxX <= minX) {
+        return; // Nothing to draw
+    }
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(font, ch, white);
+    if (surface == nullptr) {
+        return;
+    }
+
+    SDL_Rect area;
+    if (Reserve(surface->w, surface->h, area)) {
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(surface, nullptr, pixels, &area);
+        const uint8_t* start = static_cast<const uint8_t*>(pixels->pixels) + area.y * pixels->pitch + area.x * 4;
+        SDL_UpdateTexture(texture, &area, start, pixels->pitch);
+        glyph.source = area;
+    }
+    SDL_FreeSurface(surface);
+}
+
+// Find room for a width x height bitmap, growing the atlas if it is full
+bool GlyphAtlas::Reserve(int width, int height, SDL_Rect& area) {
+    if (width + GlyphPadding > AtlasWidth) {
+        return false;
+    }
+    if (shelfX + width + GlyphPadding > AtlasWidth) {
+        // Start a new shelf under the current one
+        shelfY += shelfHeight + GlyphPadding;
+        shelfX = 0;
+        shelfHeight = 0;
+    }
+    while (shelfY + height + GlyphPadding > pixels->h) {
+        if (!Grow()) {
+            return false;
+        }
+    }
+
+    area = { shelfX, shelfY, width, height };
+    shelfX += width + GlyphPadding;
+    shelfHeight = std::max(shelfHeight, height);
+    return true;
+}
+
+// Double the atlas height, keeping every glyph where it is
+bool GlyphAtlas::Grow() {
+    int height = pixels->h * 2;
+    if (height > MaxAtlasHeight) {
+        std::cerr << "Glyph atlas is full." << std::endl;
+        return false;
+    }
+
+    SDL_Surface* grown = SDL_CreateRGBSurfaceWithFormat(0, AtlasWidth, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (grown == nullptr) {
+        return false;
+    }
+    SDL_FillRect(grown, nullptr, 0);
+    SDL_SetSurfaceBlendMode(pixels, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(pixels, nullptr, grown, nullptr);
+    SDL_Texture* grownTexture = CreateTexture(renderer, grown);
+    if (grownTexture == nullptr) {
+        SDL_FreeSurface(grown);
+        return false;
+    }
+
+    // Queued vertices hold pixel coordinates, so they stay valid
+    SDL_FreeSurface(pixels);
+    SDL_DestroyTexture(texture);
+    pixels = grown;
+    texture = grownTexture;
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <string_view>
+#include <vector>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// Where one rasterized glyph lives in the atlas
+struct AtlasGlyph {
+    SDL_Rect source; // Area of the atlas (empty for glyphs without pixels, like space)
+    int offsetX;     // Left edge of the bitmap relative to the pen position
+    int advance;     // How far the pen moves after this glyph
+    bool loaded;
+};
+
+// Rasterizes each glyph of a font once, in white, into one shared texture,
+// and draws text as textured quads tinted by the vertex color. Text is only
+// queued by AddText; Flush draws everything queued with a single
+// SDL_RenderGeometry call, so a whole frame of text costs one draw and no
+// texture uploads once its glyphs are in the atlas.
+//
+// Text is treated as Latin-1, one glyph per byte, like TTF_RenderText.
+// Printable ASCII is rasterized up front; other glyphs when first used.
+class GlyphAtlas {
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    // Start a new atlas for a font (the font must outlive the atlas or the next Build/Release)
+    bool Build(SDL_Renderer* renderer, TTF_Font* font);
+
+    // Free the texture; call before the renderer is destroyed
+    void Release();
+
+    // Upload the atlas again from its CPU copy, after the renderer lost its
+    // textures. Glyphs keep their places, so quads built earlier stay valid.
+    bool RecreateTexture();
+
+    // Queue a line of text with its top left corner at (x, y); returns its width
+    int AddText(std::string_view text, int x, int y, SDL_Color color);
+
+    // Width of a line of text as AddText would draw it, without queuing anything
+    int MeasureText(std::string_view text);
+
+    // Build the quads for a line of text into the given arrays instead of the
+    // queue, so they can be kept and queued again later with AddGeometry.
+    // Texture coordinates are in atlas pixels.
+    int BuildText(std::string_view text, int x, int y, SDL_Color color,
+        std::vector<SDL_Vertex>& outVertices, std::vector<int>& outIndices);
+
+    // Queue quads made by BuildText, moved by (x, y)
+    void AddGeometry(const std::vector<SDL_Vertex>& geometryVertices, const std::vector<int>& geometryIndices, int x, int y);
+
+    // Draw and clear everything queued
+    void Flush();
+
+    // Clear everything queued without drawing it
+    void Discard();
+
+private:
+    const AtlasGlyph& GetGlyph(unsigned char ch);
+    void LoadGlyph(unsigned char ch);
+    bool Reserve(int width, int height, SDL_Rect& area);
+    bool Grow();
+
+    SDL_Renderer* renderer;
+    TTF_Font* font;
+    SDL_Surface* pixels;  // CPU copy of the atlas, so it can grow without re-rasterizing
+    SDL_Texture* texture;
+    int shelfX;           // Packing position: glyphs fill shelves left to right
+    int shelfY;
+    int shelfHeight;
+    bool kerning;
+    AtlasGlyph glyphs[256];
+    std::vector<SDL_Vertex> vertices; // Texture coordinates are in pixels until Flush
+    std::vector<int> indices;
+};
+
+#endif // GLYPH_ATLAS_H
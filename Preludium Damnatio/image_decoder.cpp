@@ -0,0 +1,220 @@
+#include "image_decoder.h"
+#include "prepared_image.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const size_t NoJob = static_cast<size_t>(-1);
+
+    // Read a prepared image into a surface of the same pixel format, or return nullptr
+    SDL_Surface* LoadPreparedImage(const std::string& preparedFile) {
+        std::ifstream file(preparedFile, std::ios::in | std::ios::binary);
+        if (!file) {
+            return nullptr;
+        }
+
+        PreparedImageHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !IsPreparedImageHeader(header)) {
+            std::cerr << "Ignoring invalid prepared image: " << preparedFile << std::endl;
+            return nullptr;
+        }
+
+        int width = static_cast<int>(header.width);
+        int height = static_cast<int>(header.height);
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (surface == nullptr) {
+            return nullptr;
+        }
+
+        // The rows are stored unpadded; read them in one go when the surface has no padding either
+        std::streamsize rowBytes = static_cast<std::streamsize>(width) * 4;
+        if (surface->pitch == rowBytes) {
+            file.read(static_cast<char*>(surface->pixels), rowBytes * height);
+        }
+        else {
+            for (int y = 0; y < height && file; ++y) {
+                file.read(static_cast<char*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch, rowBytes);
+            }
+        }
+        if (!file) {
+            std::cerr << "Truncated prepared image: " << preparedFile << std::endl;
+            SDL_FreeSurface(surface);
+            return nullptr;
+        }
+        return surface;
+    }
+}
+
+// Load an image for display, preferring its prepared form unless the image was edited since
+SDL_Surface* LoadImageSurface(const std::string& file) {
+    std::string preparedFile = GetPreparedImageFile(file);
+    SDL_Surface* surface = nullptr;
+    if (IsBuiltFileCurrent(preparedFile, file)) {
+        surface = LoadPreparedImage(preparedFile);
+    }
+    if (surface == nullptr) {
+        surface = SDL_LoadBMP(file.c_str());
+    }
+    return surface;
+}
+
+ImageDecoder::ImageDecoder(int threadCount) : threadCount(std::max(threadCount, 1)), stopping(false), stats() {}
+
+ImageDecoder::~ImageDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (std::unique_ptr<Job>& job : jobs) {
+        if (job->surface) {
+            SDL_FreeSurface(job->surface);
+        }
+    }
+}
+
+// Replace the set of images to have ready
+void ImageDecoder::Prefetch(const std::vector<std::string_view>& files) {
+    std::vector<SDL_Surface*> dropped; // Freed outside the lock
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Forget the images that are no longer wanted
+        for (size_t i = jobs.size(); i-- > 0;) {
+            Job& job = *jobs[i];
+            if (std::find(files.begin(), files.end(), std::string_view(job.file)) != files.end()) {
+                job.wanted = true;
+                continue;
+            }
+            if (job.state == JobState::Queued) {
+                ++stats.cancelled;
+                RemoveJob(i);
+            }
+            else if (job.state == JobState::Decoding) {
+                job.wanted = false; // The decoding thread drops it when done
+            }
+            else {
+                ++stats.wasted;
+                dropped.push_back(job.surface);
+                RemoveJob(i);
+            }
+        }
+
+        // Queue the new ones
+        for (std::string_view file : files) {
+            if (!file.empty() && FindJob(file) == NoJob) {
+                jobs.emplace_back(new Job{ std::string(file), JobState::Queued, true, nullptr });
+                ++stats.requested;
+                queued = true;
+            }
+        }
+    }
+
+    for (SDL_Surface* surface : dropped) {
+        if (surface) {
+            SDL_FreeSurface(surface);
+        }
+    }
+    if (queued) {
+        if (threads.empty()) {
+            Start();
+        }
+        workAvailable.notify_all();
+    }
+}
+
+// The decoded image, if it was prefetched
+SDL_Surface* ImageDecoder::Take(std::string_view file) {
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t index = FindJob(file);
+    if (index == NoJob || jobs[index]->state == JobState::Queued) {
+        // Not worth waiting for a decode that has not started; the caller loads it now
+        if (index != NoJob) {
+            RemoveJob(index);
+        }
+        ++stats.misses;
+        return nullptr;
+    }
+
+    if (jobs[index]->state == JobState::Decoding) {
+        ++stats.lateHits;
+        Job* job = jobs[index].get();
+        job->wanted = true; // Claim it, so the decoding thread does not drop it
+        jobFinished.wait(lock, [job] { return job->state == JobState::Ready; });
+        index = FindJob(file);
+    }
+    else {
+        ++stats.hits;
+    }
+
+    SDL_Surface* surface = jobs[index]->surface;
+    RemoveJob(index);
+    return surface;
+}
+
+ImageDecodeStats ImageDecoder::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void ImageDecoder::Start() {
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&ImageDecoder::Run, this);
+    }
+}
+
+// Decoding thread: take the oldest queued image and decode it
+void ImageDecoder::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        Job* job = nullptr;
+        workAvailable.wait(lock, [this, &job] {
+            for (std::unique_ptr<Job>& candidate : jobs) {
+                if (candidate->state == JobState::Queued) {
+                    job = candidate.get();
+                    return true;
+                }
+            }
+            return stopping;
+        });
+        if (job == nullptr) {
+            return; // Stopping
+        }
+
+        job->state = JobState::Decoding;
+        std::string file = job->file;
+        lock.unlock();
+        SDL_Surface* surface = LoadImageSurface(file);
+        lock.lock();
+
+        // Jobs being decoded are never removed, so job is still valid
+        job->surface = surface;
+        job->state = JobState::Ready;
+        if (!job->wanted) {
+            ++stats.wasted;
+            if (surface) {
+                SDL_FreeSurface(surface);
+            }
+            RemoveJob(FindJob(file));
+        }
+        jobFinished.notify_all();
+    }
+}
+
+size_t ImageDecoder::FindJob(std::string_view file) const {
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i]->file == file) {
+            return i;
+        }
+    }
+    return NoJob;
+}
+
+void ImageDecoder::RemoveJob(size_t index) {
+    jobs.erase(jobs.begin() + index);
+}
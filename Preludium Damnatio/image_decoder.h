@@ -0,0 +1,77 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+
+// Load an image for display: the prepared image written by the story
+// compiler (already scaled and in texture format) if there is one no older
+// than the BMP, otherwise the BMP itself. Returns nullptr if neither loads.
+SDL_Surface* LoadImageSurface(const std::string& file);
+
+// Counters for the image decoder
+struct ImageDecodeStats {
+    uint64_t requested;  // Decodes queued by Prefetch
+    uint64_t hits;       // Take found the image already decoded
+    uint64_t lateHits;   // Take had to wait for a decode already under way
+    uint64_t misses;     // Take asked for an image that was not prefetched (or not started yet)
+    uint64_t wasted;     // Images decoded and then dropped without being taken
+    uint64_t cancelled;  // Queued decodes dropped before they started
+};
+
+// Decodes images on background threads ahead of time. Prefetch names the
+// images that may be needed next; Take hands one over once the main thread
+// actually needs it, so only the GPU upload is left to do there. The threads
+// are started by the first Prefetch.
+class ImageDecoder {
+public:
+    explicit ImageDecoder(int threadCount = 2);
+    ~ImageDecoder();
+
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+    // Replace the set of images to have ready: queue the new ones, and
+    // cancel or drop the ones no longer listed
+    void Prefetch(const std::vector<std::string_view>& files);
+
+    // The decoded image, if it was prefetched; waits if it is being decoded.
+    // Returns nullptr if it was not prefetched or its decode has not started
+    // (the caller is better off loading it itself). The caller frees the surface.
+    SDL_Surface* Take(std::string_view file);
+
+    ImageDecodeStats GetStats() const;
+
+private:
+    enum class JobState { Queued, Decoding, Ready };
+
+    struct Job {
+        std::string file;
+        JobState state;
+        bool wanted;          // Cleared if Prefetch drops it while it is being decoded
+        SDL_Surface* surface; // Set once Ready (nullptr if the file failed to load)
+    };
+
+    void Start();
+    void Run();
+    size_t FindJob(std::string_view file) const;
+    void RemoveJob(size_t index);
+
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable jobFinished;
+    std::vector<std::unique_ptr<Job>> jobs; // A handful at a time: the neighbours of one node
+    std::vector<std::thread> threads;
+    int threadCount;
+    bool stopping;
+    ImageDecodeStats stats;
+};
+
+#endif // IMAGE_DECODER_H
@@ -0,0 +1,304 @@
+#include "image_source.h"
+#include "inflate.h"
+#include "save_file.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const uint8_t PngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+    uint16_t ReadLittle16(const uint8_t* data) {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+
+    uint32_t ReadLittle32(const uint8_t* data) {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+            | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    uint32_t ReadBig32(const uint8_t* data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16)
+            | (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+    }
+
+    uint32_t PackArgb(uint32_t alpha, uint32_t red, uint32_t green, uint32_t blue) {
+        return (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+
+    // One channel of a BMP bit field pixel, scaled to 8 bits
+    struct ChannelMask {
+        uint32_t mask;
+        int shift;
+        uint32_t maximum;
+
+        explicit ChannelMask(uint32_t mask) : mask(mask), shift(0), maximum(0) {
+            if (mask != 0) {
+                while (((mask >> shift) & 1) == 0) {
+                    ++shift;
+                }
+                maximum = mask >> shift;
+            }
+        }
+
+        uint32_t Extract(uint32_t pixel, uint32_t absent) const {
+            if (maximum == 0) {
+                return absent;
+            }
+            uint32_t value = (pixel & mask) >> shift;
+            return maximum == 255 ? value : (value * 255 + maximum / 2) / maximum;
+        }
+    };
+
+    bool DecodeBmp(const std::vector<uint8_t>& data, const std::string& file, PixelImage& image) {
+        if (data.size() < 54) {
+            std::cerr << "Truncated BMP: " << file << std::endl;
+            return false;
+        }
+        uint32_t pixelOffset = ReadLittle32(&data[10]);
+        uint32_t headerSize = ReadLittle32(&data[14]);
+        int32_t width = static_cast<int32_t>(ReadLittle32(&data[18]));
+        int32_t height = static_cast<int32_t>(ReadLittle32(&data[22]));
+        uint16_t bitsPerPixel = ReadLittle16(&data[28]);
+        uint32_t compression = ReadLittle32(&data[30]);
+
+        // Bottom-up unless the height is negative
+        bool topDown = height < 0;
+        height = topDown ? -height : height;
+        if (width <= 0 || height <= 0 || width > 16384 || height > 16384 || (bitsPerPixel != 24 && bitsPerPixel != 32)) {
+            std::cerr << "Unsupported BMP (only 24 and 32 bits per pixel): " << file << std::endl;
+            return false;
+        }
+
+        // Uncompressed pixels are BGR(A); bit fields give the masks after the basic header
+        ChannelMask red(0x00ff0000), green(0x0000ff00), blue(0x000000ff), alpha(bitsPerPixel == 32 ? 0xff000000 : 0);
+        if (compression == 3 || compression == 6) {
+            size_t masks = headerSize >= 52 ? 14 + 40 : 14 + headerSize;
+            if (data.size() < masks + 12) {
+                std::cerr << "Truncated BMP: " << file << std::endl;
+                return false;
+            }
+            red = ChannelMask(ReadLittle32(&data[masks]));
+            green = ChannelMask(ReadLittle32(&data[masks + 4]));
+            blue = ChannelMask(ReadLittle32(&data[masks + 8]));
+            alpha = ChannelMask(headerSize >= 56 || compression == 6 ? ReadLittle32(&data[masks + 12]) : 0);
+        }
+        else if (compression != 0) {
+            std::cerr << "Unsupported BMP compression: " << file << std::endl;
+            return false;
+        }
+
+        size_t bytesPerPixel = bitsPerPixel / 8;
+        size_t rowBytes = (static_cast<size_t>(width) * bytesPerPixel + 3) & ~static_cast<size_t>(3);
+        if (pixelOffset > data.size() || data.size() - pixelOffset < rowBytes * height) {
+            std::cerr << "Truncated BMP: " << file << std::endl;
+            return false;
+        }
+
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(static_cast<size_t>(width) * height);
+        bool anyAlpha = false;
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* row = &data[pixelOffset + rowBytes * (topDown ? y : height - 1 - y)];
+            uint32_t* out = &image.pixels[static_cast<size_t>(y) * width];
+            for (int x = 0; x < width; ++x) {
+                const uint8_t* source = row + x * bytesPerPixel;
+                uint32_t pixel = bytesPerPixel == 4 ? ReadLittle32(source) : (source[0] | (source[1] << 8) | (source[2] << 16));
+                uint32_t pixelAlpha = alpha.Extract(pixel, 255);
+                anyAlpha = anyAlpha || pixelAlpha != 0;
+                out[x] = PackArgb(pixelAlpha, red.Extract(pixel, 0), green.Extract(pixel, 0), blue.Extract(pixel, 0));
+            }
+        }
+
+        // Many tools write 32-bit BMPs with the alpha byte left at zero; treat those as opaque, like SDL does
+        if (!anyAlpha) {
+            for (uint32_t& pixel : image.pixels) {
+                pixel |= 0xff000000;
+            }
+        }
+        return true;
+    }
+
+    uint8_t Paeth(int left, int up, int upLeft) {
+        int estimate = left + up - upLeft;
+        int toLeft = std::abs(estimate - left);
+        int toUp = std::abs(estimate - up);
+        int toUpLeft = std::abs(estimate - upLeft);
+        if (toLeft <= toUp && toLeft <= toUpLeft) {
+            return static_cast<uint8_t>(left);
+        }
+        return static_cast<uint8_t>(toUp <= toUpLeft ? up : upLeft);
+    }
+
+    bool DecodePng(const std::vector<uint8_t>& data, const std::string& file, PixelImage& image) {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        int colorType = -1;
+        std::vector<uint8_t> compressed;
+        std::vector<uint32_t> palette;
+
+        // Collect the header, palette and image data chunks
+        size_t position = sizeof(PngSignature);
+        bool ended = false;
+        while (!ended && data.size() - position >= 12) {
+            uint32_t length = ReadBig32(&data[position]);
+            const uint8_t* type = &data[position + 4];
+            const uint8_t* chunk = &data[position + 8];
+            if (data.size() - position - 12 < length) {
+                break;
+            }
+
+            if (std::memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+                width = ReadBig32(chunk);
+                height = ReadBig32(chunk + 4);
+                int bitDepth = chunk[8];
+                colorType = chunk[9];
+                int interlace = chunk[12];
+                if (bitDepth != 8 || interlace != 0 || (colorType != 0 && colorType != 2 && colorType != 3 && colorType != 4 && colorType != 6)) {
+                    std::cerr << "Unsupported PNG (only 8 bits per channel, not interlaced): " << file << std::endl;
+                    return false;
+                }
+            }
+            else if (std::memcmp(type, "PLTE", 4) == 0) {
+                for (uint32_t i = 0; i + 3 <= length; i += 3) {
+                    palette.push_back(PackArgb(255, chunk[i], chunk[i + 1], chunk[i + 2]));
+                }
+            }
+            else if (std::memcmp(type, "tRNS", 4) == 0 && colorType == 3) {
+                for (uint32_t i = 0; i < length && i < palette.size(); ++i) {
+                    palette[i] = (palette[i] & 0x00ffffff) | (static_cast<uint32_t>(chunk[i]) << 24);
+                }
+            }
+            else if (std::memcmp(type, "IDAT", 4) == 0) {
+                compressed.insert(compressed.end(), chunk, chunk + length);
+            }
+            else if (std::memcmp(type, "IEND", 4) == 0) {
+                ended = true;
+            }
+            position += 12 + static_cast<size_t>(length);
+        }
+
+        if (colorType < 0 || width == 0 || height == 0 || width > 16384 || height > 16384 || !ended) {
+            std::cerr << "Truncated or invalid PNG: " << file << std::endl;
+            return false;
+        }
+        if (colorType == 3 && palette.empty()) {
+            std::cerr << "PNG has no palette: " << file << std::endl;
+            return false;
+        }
+
+        // Each row is a filter type byte followed by the filtered bytes
+        const size_t channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+        size_t bytesPerPixel = channels[colorType];
+        size_t rowBytes = width * bytesPerPixel;
+        std::vector<uint8_t> filtered;
+        filtered.reserve((rowBytes + 1) * height);
+        if (!Inflate(compressed.data(), compressed.size(), filtered) || filtered.size() < (rowBytes + 1) * height) {
+            std::cerr << "Corrupt PNG image data: " << file << std::endl;
+            return false;
+        }
+
+        // Undo the filters in place, each row against the one above
+        std::vector<uint8_t> previous(rowBytes, 0);
+        image.width = static_cast<int>(width);
+        image.height = static_cast<int>(height);
+        image.pixels.resize(static_cast<size_t>(width) * height);
+        for (uint32_t y = 0; y < height; ++y) {
+            uint8_t filter = filtered[y * (rowBytes + 1)];
+            uint8_t* row = &filtered[y * (rowBytes + 1) + 1];
+            for (size_t i = 0; i < rowBytes; ++i) {
+                int left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+                int up = previous[i];
+                int upLeft = i >= bytesPerPixel ? previous[i - bytesPerPixel] : 0;
+                switch (filter) {
+                case 0: break;
+                case 1: row[i] = static_cast<uint8_t>(row[i] + left); break;
+                case 2: row[i] = static_cast<uint8_t>(row[i] + up); break;
+                case 3: row[i] = static_cast<uint8_t>(row[i] + (left + up) / 2); break;
+                case 4: row[i] = static_cast<uint8_t>(row[i] + Paeth(left, up, upLeft)); break;
+                default:
+                    std::cerr << "Corrupt PNG row filter: " << file << std::endl;
+                    return false;
+                }
+            }
+            std::memcpy(previous.data(), row, rowBytes);
+
+            uint32_t* out = &image.pixels[static_cast<size_t>(y) * width];
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint8_t* pixel = row + x * bytesPerPixel;
+                switch (colorType) {
+                case 0: out[x] = PackArgb(255, pixel[0], pixel[0], pixel[0]); break;
+                case 2: out[x] = PackArgb(255, pixel[0], pixel[1], pixel[2]); break;
+                case 3: out[x] = pixel[0] < palette.size() ? palette[pixel[0]] : 0xff000000; break;
+                case 4: out[x] = PackArgb(pixel[1], pixel[0], pixel[0], pixel[0]); break;
+                default: out[x] = PackArgb(pixel[3], pixel[0], pixel[1], pixel[2]); break;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+// Decode a BMP or PNG file, whichever it turns out to be
+bool LoadSourceImage(const std::string& file, PixelImage& image) {
+    std::vector<uint8_t> data;
+    if (!ReadWholeFile(file, data)) {
+        std::cerr << "Could not read image: " << file << std::endl;
+        return false;
+    }
+    if (data.size() >= sizeof(PngSignature) && std::memcmp(data.data(), PngSignature, sizeof(PngSignature)) == 0) {
+        return DecodePng(data, file, image);
+    }
+    if (data.size() >= 2 && data[0] == 'B' && data[1] == 'M') {
+        return DecodeBmp(data, file, image);
+    }
+    std::cerr << "Not a BMP or PNG image: " << file << std::endl;
+    return false;
+}
+
+// Resample with bilinear filtering, sampling at pixel centers
+PixelImage ScaleImage(const PixelImage& source, int width, int height) {
+    PixelImage scaled;
+    scaled.width = width;
+    scaled.height = height;
+    scaled.pixels.resize(static_cast<size_t>(width) * height);
+
+    // Horizontal sample positions are the same on every row
+    std::vector<int> left(width), right(width);
+    std::vector<float> rightWeight(width);
+    for (int x = 0; x < width; ++x) {
+        float position = std::max(0.0f, (x + 0.5f) * source.width / width - 0.5f);
+        left[x] = std::min(static_cast<int>(position), source.width - 1);
+        right[x] = std::min(left[x] + 1, source.width - 1);
+        rightWeight[x] = position - left[x];
+    }
+
+    for (int y = 0; y < height; ++y) {
+        float position = std::max(0.0f, (y + 0.5f) * source.height / height - 0.5f);
+        int top = std::min(static_cast<int>(position), source.height - 1);
+        int bottom = std::min(top + 1, source.height - 1);
+        float bottomWeight = position - top;
+        const uint32_t* topRow = &source.pixels[static_cast<size_t>(top) * source.width];
+        const uint32_t* bottomRow = &source.pixels[static_cast<size_t>(bottom) * source.width];
+        uint32_t* out = &scaled.pixels[static_cast<size_t>(y) * width];
+
+        for (int x = 0; x < width; ++x) {
+            uint32_t corners[4] = { topRow[left[x]], topRow[right[x]], bottomRow[left[x]], bottomRow[right[x]] };
+            float weights[4] = {
+                (1 - rightWeight[x]) * (1 - bottomWeight), rightWeight[x] * (1 - bottomWeight),
+                (1 - rightWeight[x]) * bottomWeight, rightWeight[x] * bottomWeight };
+            uint32_t pixel = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                float channel = 0.0f;
+                for (int corner = 0; corner < 4; ++corner) {
+                    channel += ((corners[corner] >> shift) & 0xff) * weights[corner];
+                }
+                pixel |= static_cast<uint32_t>(std::min(255.0f, channel + 0.5f)) << shift;
+            }
+            out[x] = pixel;
+        }
+    }
+    return scaled;
+}
@@ -0,0 +1,15 @@
+#ifndef IMAGE_SOURCE_H
+#define IMAGE_SOURCE_H
+
+#include "prepared_image.h"
+#include <string>
+
+// Decode a source image file for the story compiler: BMP (24 or 32 bits per
+// pixel, uncompressed or with bit field masks) or PNG (8 bits per channel,
+// not interlaced). Reports the reason on std::cerr if it fails.
+bool LoadSourceImage(const std::string& file, PixelImage& image);
+
+// Resample an image to a new size with bilinear filtering
+PixelImage ScaleImage(const PixelImage& source, int width, int height);
+
+#endif // IMAGE_SOURCE_H
@@ -0,0 +1,285 @@
+#include "inflate.h"
+
+namespace {
+    const int MaxCodeBits = 15;
+    const int MaxLiteralCodes = 288;
+    const int MaxDistanceCodes = 30;
+
+    // Base lengths and extra bits of length codes 257..285
+    const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+    // Base distances and extra bits of distance codes 0..29
+    const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // Order the code length code lengths are stored in
+    const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Reads the stream least significant bit first
+    struct BitReader {
+        const uint8_t* data;
+        size_t size;
+        size_t position;
+        uint32_t buffer;
+        int bitCount;
+        bool overrun; // Set once a read went past the end
+
+        int Bits(int count) {
+            while (bitCount < count) {
+                if (position == size) {
+                    overrun = true;
+                    return 0;
+                }
+                buffer |= static_cast<uint32_t>(data[position++]) << bitCount;
+                bitCount += 8;
+            }
+            int value = static_cast<int>(buffer & ((1u << count) - 1));
+            buffer >>= count;
+            bitCount -= count;
+            return value;
+        }
+
+        // Drop the bits left in the current byte
+        void AlignToByte() {
+            buffer = 0;
+            bitCount = 0;
+        }
+    };
+
+    // Canonical Huffman code: how many codes of each length, and the symbols in code order
+    struct Huffman {
+        uint16_t count[MaxCodeBits + 1];
+        uint16_t symbol[MaxLiteralCodes];
+
+        // Returns false if the lengths describe more codes than fit
+        bool Build(const uint8_t* lengths, int symbolCount) {
+            for (int length = 0; length <= MaxCodeBits; ++length) {
+                count[length] = 0;
+            }
+            for (int i = 0; i < symbolCount; ++i) {
+                ++count[lengths[i]];
+            }
+
+            int left = 1;
+            for (int length = 1; length <= MaxCodeBits; ++length) {
+                left = (left << 1) - count[length];
+                if (left < 0) {
+                    return false;
+                }
+            }
+
+            uint16_t offsets[MaxCodeBits + 1];
+            offsets[1] = 0;
+            for (int length = 1; length < MaxCodeBits; ++length) {
+                offsets[length + 1] = offsets[length] + count[length];
+            }
+            for (int i = 0; i < symbolCount; ++i) {
+                if (lengths[i] != 0) {
+                    symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+                }
+            }
+            return true;
+        }
+
+        // Next symbol from the stream, or -1 if no code matches
+        int Decode(BitReader& reader) const {
+            int code = 0;
+            int first = 0;
+            int index = 0;
+            for (int length = 1; length <= MaxCodeBits; ++length) {
+                code |= reader.Bits(1);
+                int lengthCount = count[length];
+                if (code - lengthCount < first) {
+                    return symbol[index + (code - first)];
+                }
+                index += lengthCount;
+                first += lengthCount;
+                first <<= 1;
+                code <<= 1;
+            }
+            return -1;
+        }
+    };
+
+    // Copy a stored (uncompressed) block
+    bool CopyStored(BitReader& reader, std::vector<uint8_t>& output) {
+        reader.AlignToByte();
+        if (reader.size - reader.position < 4) {
+            return false;
+        }
+        const uint8_t* header = reader.data + reader.position;
+        unsigned length = header[0] | (header[1] << 8);
+        unsigned complement = header[2] | (header[3] << 8);
+        reader.position += 4;
+        if (length != (~complement & 0xffff) || reader.size - reader.position < length) {
+            return false;
+        }
+        output.insert(output.end(), reader.data + reader.position, reader.data + reader.position + length);
+        reader.position += length;
+        return true;
+    }
+
+    // Decode literals and length/distance pairs until the end of block code
+    bool DecodeCodes(BitReader& reader, const Huffman& literals, const Huffman& distances, std::vector<uint8_t>& output, size_t streamStart) {
+        for (;;) {
+            int symbol = literals.Decode(reader);
+            if (symbol < 0 || reader.overrun) {
+                return false;
+            }
+            if (symbol < 256) {
+                output.push_back(static_cast<uint8_t>(symbol));
+                continue;
+            }
+            if (symbol == 256) {
+                return true; // End of block
+            }
+
+            symbol -= 257;
+            if (symbol >= 29) {
+                return false;
+            }
+            size_t length = LengthBase[symbol] + reader.Bits(LengthExtra[symbol]);
+            int distanceSymbol = distances.Decode(reader);
+            if (distanceSymbol < 0 || distanceSymbol >= MaxDistanceCodes) {
+                return false;
+            }
+            size_t distance = DistanceBase[distanceSymbol] + reader.Bits(DistanceExtra[distanceSymbol]);
+            if (reader.overrun || distance > output.size() - streamStart) {
+                return false;
+            }
+
+            // The copy may overlap what it writes, so go byte by byte
+            size_t from = output.size() - distance;
+            for (size_t i = 0; i < length; ++i) {
+                uint8_t byte = output[from + i];
+                output.push_back(byte);
+            }
+        }
+    }
+
+    // The fixed codes of the format
+    struct FixedCodes {
+        Huffman literals;
+        Huffman distances;
+
+        FixedCodes() {
+            uint8_t lengths[MaxLiteralCodes];
+            int symbol = 0;
+            for (; symbol < 144; ++symbol) lengths[symbol] = 8;
+            for (; symbol < 256; ++symbol) lengths[symbol] = 9;
+            for (; symbol < 280; ++symbol) lengths[symbol] = 7;
+            for (; symbol < MaxLiteralCodes; ++symbol) lengths[symbol] = 8;
+            literals.Build(lengths, MaxLiteralCodes);
+            for (symbol = 0; symbol < MaxDistanceCodes; ++symbol) lengths[symbol] = 5;
+            distances.Build(lengths, MaxDistanceCodes);
+        }
+    };
+
+    // Block compressed with the fixed codes
+    bool DecodeFixed(BitReader& reader, std::vector<uint8_t>& output, size_t streamStart) {
+        static const FixedCodes fixedCodes;
+        return DecodeCodes(reader, fixedCodes.literals, fixedCodes.distances, output, streamStart);
+    }
+
+    // Block that starts with its own code tables
+    bool DecodeDynamic(BitReader& reader, std::vector<uint8_t>& output, size_t streamStart) {
+        int literalCount = reader.Bits(5) + 257;
+        int distanceCount = reader.Bits(5) + 1;
+        int codeLengthCount = reader.Bits(4) + 4;
+        if (literalCount > 286 || distanceCount > MaxDistanceCodes) {
+            return false;
+        }
+
+        uint8_t lengths[MaxLiteralCodes + MaxDistanceCodes] = {};
+        for (int i = 0; i < codeLengthCount; ++i) {
+            lengths[CodeLengthOrder[i]] = static_cast<uint8_t>(reader.Bits(3));
+        }
+        Huffman codeLengths;
+        if (!codeLengths.Build(lengths, 19)) {
+            return false;
+        }
+
+        // The literal and distance code lengths, run length encoded
+        int index = 0;
+        while (index < literalCount + distanceCount) {
+            int symbol = codeLengths.Decode(reader);
+            if (symbol < 0 || reader.overrun) {
+                return false;
+            }
+            if (symbol < 16) {
+                lengths[index++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t repeated = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (index == 0) {
+                    return false; // Nothing to repeat
+                }
+                repeated = lengths[index - 1];
+                repeat = 3 + reader.Bits(2);
+            }
+            else if (symbol == 17) {
+                repeat = 3 + reader.Bits(3);
+            }
+            else {
+                repeat = 11 + reader.Bits(7);
+            }
+            if (index + repeat > literalCount + distanceCount) {
+                return false;
+            }
+            while (repeat-- > 0) {
+                lengths[index++] = repeated;
+            }
+        }
+        if (lengths[256] == 0) {
+            return false; // No end of block code
+        }
+
+        Huffman literals;
+        Huffman distances;
+        if (!literals.Build(lengths, literalCount) || !distances.Build(lengths + literalCount, distanceCount)) {
+            return false;
+        }
+        return DecodeCodes(reader, literals, distances, output, streamStart);
+    }
+}
+
+// Decompress a zlib stream
+bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& output) {
+    // Two byte header: deflate, no preset dictionary, and a check value
+    if (size < 2 || (data[0] & 0x0f) != 8 || (data[1] & 0x20) != 0 || ((data[0] << 8) | data[1]) % 31 != 0) {
+        return false;
+    }
+
+    BitReader reader = { data, size, 2, 0, 0, false };
+    size_t streamStart = output.size();
+    bool lastBlock = false;
+    while (!lastBlock) {
+        lastBlock = reader.Bits(1) != 0;
+        int type = reader.Bits(2);
+        bool decoded;
+        if (type == 0) {
+            decoded = CopyStored(reader, output);
+        }
+        else if (type == 1) {
+            decoded = DecodeFixed(reader, output, streamStart);
+        }
+        else if (type == 2) {
+            decoded = DecodeDynamic(reader, output, streamStart);
+        }
+        else {
+            decoded = false;
+        }
+        if (!decoded || reader.overrun) {
+            return false;
+        }
+    }
+    return true; // The Adler-32 trailer is not checked
+}
@@ -0,0 +1,13 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decompress a zlib stream (RFC 1950 wrapping RFC 1951 deflate data), as
+// found in the image data of a PNG file. The decompressed bytes are
+// appended to output. Returns false if the stream is malformed or truncated.
+bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+
+#endif // INFLATE_H
@@ -33,6 +33,31 @@ int InputManager::GetPlayerChoice(int optionsCount) {
     return choice;
 }
 
+// Choice picked by a window event, or 0
+int InputManager::GetEventChoice(const SDL_Event& event, const std::vector<SDL_Rect>& optionBoxes) const {
+    int optionsCount = static_cast<int>(optionBoxes.size());
+    int choice = 0;
+    if (event.type == SDL_KEYDOWN && event.key.repeat == 0) {
+        SDL_Keycode key = event.key.keysym.sym;
+        if (key >= SDLK_1 && key <= SDLK_9) {
+            choice = key - SDLK_1 + 1;
+        }
+        else if (key >= SDLK_KP_1 && key <= SDLK_KP_9) {
+            choice = key - SDLK_KP_1 + 1;
+        }
+    }
+    else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+        SDL_Point point = { event.button.x, event.button.y };
+        for (int i = 0; i < optionsCount; ++i) {
+            if (SDL_PointInRect(&point, &optionBoxes[i])) {
+                choice = i + 1;
+                break;
+            }
+        }
+    }
+    return choice <= optionsCount ? choice : 0;
+}
+
 // Get a string input from the player
 std::string InputManager::GetStringInput(const std::string& prompt) {
     std::string input;
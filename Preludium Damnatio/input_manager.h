@@ -3,11 +3,18 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <SDL.h>
 
 class InputManager {
 public:
     int GetPlayerChoice(int optionsCount);
 
+    // Choice picked by a window event: a number key (1-9, top row or keypad)
+    // or a left click on one of the options drawn in optionBoxes. Returns the
+    // choice (1 based) or 0 if the event does not pick one.
+    int GetEventChoice(const SDL_Event& event, const std::vector<SDL_Rect>& optionBoxes) const;
+
     std::string GetStringInput(const std::string& prompt);
 
     void ClearConsole();
@@ -0,0 +1,113 @@
+#include "line_breaker.h"
+
+namespace {
+    // Widths kept before the cache is cleared and starts over
+    const size_t MaxCachedWords = 16384;
+
+    // Whitespace as istringstream sees it
+    bool IsWrapSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Next word of text at or after position; false when there are no more
+    bool NextWord(std::string_view text, size_t end, size_t& position, size_t& wordStart, size_t& wordEnd) {
+        while (position < end && IsWrapSpace(text[position])) {
+            ++position;
+        }
+        if (position >= end) {
+            return false;
+        }
+        wordStart = position;
+        while (position < end && !IsWrapSpace(text[position])) {
+            ++position;
+        }
+        wordEnd = position;
+        return true;
+    }
+}
+
+LineBreaker::LineBreaker(GlyphAtlas& atlas) : atlas(atlas), spaceWidth(-1) {}
+
+// Forget every width
+void LineBreaker::Clear() {
+    wordWidths.clear();
+    spaceWidth = -1;
+}
+
+// Split text into lines no wider than maxWidth
+void LineBreaker::Break(std::string_view text, int maxWidth, std::vector<LineBreak>& lines) {
+    lines.clear();
+    int space = GetSpaceWidth();
+    LineBreak line = { 0, 0, 0 };
+    bool lineEmpty = true;
+
+    size_t position = 0;
+    size_t wordStart = 0;
+    size_t wordEnd = 0;
+    while (NextWord(text, text.size(), position, wordStart, wordEnd)) {
+        int wordWidth = GetWordWidth(text.substr(wordStart, wordEnd - wordStart));
+        if (lineEmpty) {
+            line = { static_cast<uint32_t>(wordStart), static_cast<uint32_t>(wordEnd), wordWidth };
+            lineEmpty = false;
+        }
+        else if (line.width + space + wordWidth > maxWidth) {
+            // The word does not fit: it starts the next line
+            lines.push_back(line);
+            line = { static_cast<uint32_t>(wordStart), static_cast<uint32_t>(wordEnd), wordWidth };
+        }
+        else {
+            line.end = static_cast<uint32_t>(wordEnd);
+            line.width += space + wordWidth;
+        }
+    }
+    if (!lineEmpty) {
+        lines.push_back(line);
+    }
+}
+
+// The words of a line and their positions
+void LineBreaker::PlaceWords(std::string_view text, const LineBreak& line, std::vector<PlacedWord>& words) {
+    words.clear();
+    int x = 0;
+    size_t position = line.start;
+    size_t wordStart = 0;
+    size_t wordEnd = 0;
+    while (NextWord(text, line.end, position, wordStart, wordEnd)) {
+        words.push_back({ static_cast<uint32_t>(wordStart), static_cast<uint32_t>(wordEnd), x });
+        x += GetWordWidth(text.substr(wordStart, wordEnd - wordStart)) + GetSpaceWidth();
+    }
+}
+
+// Width of one word, measured on first use
+int LineBreaker::GetWordWidth(std::string_view word) {
+    // 64-bit FNV-1a of the word, with its length folded in
+    uint64_t key = 14695981039346656037ull;
+    for (char c : word) {
+        key ^= static_cast<unsigned char>(c);
+        key *= 1099511628211ull;
+    }
+    key ^= static_cast<uint64_t>(word.size()) << 48;
+
+    auto found = wordWidths.find(key);
+    if (found != wordWidths.end() && found->second.word == word) {
+        return found->second.width;
+    }
+    int width = atlas.MeasureText(word);
+    if (found != wordWidths.end()) {
+        found->second = { std::string(word), width }; // A collision; keep the newer word
+        return width;
+    }
+    if (wordWidths.size() >= MaxCachedWords) {
+        wordWidths.clear(); // Unusual text volumes; start over rather than grow without bound
+    }
+    wordWidths.emplace(key, CachedWord{ std::string(word), width });
+    return width;
+}
+
+// Advance of the space placed between words
+int LineBreaker::GetSpaceWidth() {
+    if (spaceWidth < 0) {
+        spaceWidth = atlas.MeasureText(" ");
+    }
+    return spaceWidth;
+}
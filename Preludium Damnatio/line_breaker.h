@@ -0,0 +1,64 @@
+#ifndef LINE_BREAKER_H
+#define LINE_BREAKER_H
+
+#include "glyph_atlas.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// One wrapped line: the bytes [start, end) of the original text, from the
+// first character of its first word to the last character of its last word
+struct LineBreak {
+    uint32_t start;
+    uint32_t end;
+    int width; // Words plus one space advance between each pair
+};
+
+// A word of a wrapped line and where it is drawn, relative to the line start
+struct PlacedWord {
+    uint32_t start; // Bytes [start, end) of the original text
+    uint32_t end;
+    int x;
+};
+
+// Word-wraps text in one pass. Words are separated by any run of whitespace
+// and joined by a single space, like the old istringstream loop. Each word
+// is measured once and its width is kept in a per-font cache, so wrapping a
+// paragraph costs one hash lookup per word instead of re-measuring the
+// growing line for every word.
+class LineBreaker {
+public:
+    // Widths come from the atlas's glyph advances and kerning, so they match what is drawn
+    explicit LineBreaker(GlyphAtlas& atlas);
+
+    // Forget every width (call when the font changes)
+    void Clear();
+
+    // Split text into lines no wider than maxWidth. A word wider than
+    // maxWidth gets a line of its own.
+    void Break(std::string_view text, int maxWidth, std::vector<LineBreak>& lines);
+
+    // The words of a line and their positions
+    void PlaceWords(std::string_view text, const LineBreak& line, std::vector<PlacedWord>& words);
+
+    // Width of one word, measured on first use
+    int GetWordWidth(std::string_view word);
+
+    // Advance of the space placed between words
+    int GetSpaceWidth();
+
+private:
+    // The word is kept with its width, so two words with the same hash never share a width
+    struct CachedWord {
+        std::string word;
+        int width;
+    };
+
+    GlyphAtlas& atlas;
+    std::unordered_map<uint64_t, CachedWord> wordWidths; // By hash of the word and its length
+    int spaceWidth; // -1 until measured
+};
+
+#endif // LINE_BREAKER_H
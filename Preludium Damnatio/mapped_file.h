@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file into memory, replacing any previous mapping
+    bool Open(const std::string& filename);
+
+    // Unmap the file
+    void Close();
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+private:
+    const char* data; // Start of the mapping (nullptr if nothing is mapped)
+    size_t size;      // Length of the mapping in bytes
+#ifdef _WIN32
+    void* fileHandle;    // HANDLE of the open file
+    void* mappingHandle; // HANDLE of the file mapping object
+#else
+    int fileDescriptor;
+#endif
+};
+
+#endif // MAPPED_FILE_H
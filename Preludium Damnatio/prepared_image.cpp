@@ -0,0 +1,56 @@
+#include "prepared_image.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const char PreparedImageMagic[4] = { 'P', 'D', 'I', 'M' };
+}
+
+std::string GetPreparedImageFile(std::string_view imageFile) {
+    return std::string(imageFile) + ".pimg";
+}
+
+// True if the built file exists and is no older than its source
+bool IsBuiltFileCurrent(const std::string& builtFile, const std::string& sourceFile) {
+    std::error_code error;
+    std::filesystem::file_time_type built = std::filesystem::last_write_time(builtFile, error);
+    if (error) {
+        return false; // Not built
+    }
+    std::filesystem::file_time_type source = std::filesystem::last_write_time(sourceFile, error);
+    return error || built >= source; // Only the built file was shipped, or it is up to date
+}
+
+bool IsPreparedImageHeader(const PreparedImageHeader& header) {
+    return std::memcmp(header.magic, PreparedImageMagic, sizeof(PreparedImageMagic)) == 0
+        && header.version == PreparedImageVersion
+        && header.format == PreparedImageFormat
+        && header.width > 0 && header.width <= 16384
+        && header.height > 0 && header.height <= 16384;
+}
+
+// Write an image as a prepared image file
+bool SavePreparedImage(const std::string& filename, const PixelImage& image) {
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not create prepared image: " << filename << std::endl;
+        return false;
+    }
+
+    PreparedImageHeader header = {};
+    std::memcpy(header.magic, PreparedImageMagic, sizeof(PreparedImageMagic));
+    header.version = PreparedImageVersion;
+    header.width = static_cast<uint32_t>(image.width);
+    header.height = static_cast<uint32_t>(image.height);
+    header.format = PreparedImageFormat;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(image.pixels.data()), sizeof(uint32_t) * image.pixels.size());
+    if (!file) {
+        std::cerr << "Failed to write prepared image: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef PREPARED_IMAGE_H
+#define PREPARED_IMAGE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An image as 32-bit ARGB pixels (alpha in the top byte), rows top to bottom
+struct PixelImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+};
+
+// Header of a prepared image file, written by the story compiler next to
+// each node image. The pixels follow it, rows top to bottom with no
+// padding, each pixel one little-endian ARGB word. That is the layout of
+// SDL_PIXELFORMAT_ARGB8888, the texture format the renderers use, so the
+// game reads the pixels straight into a surface and uploads them with no
+// decoding, conversion or scaling.
+struct PreparedImageHeader {
+    char magic[4];     // "PDIM"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;   // PreparedImageFormat
+    uint32_t reserved;
+};
+
+const uint32_t PreparedImageVersion = 1;
+const uint32_t PreparedImageFormat = 0x16362004; // SDL_PIXELFORMAT_ARGB8888, without including SDL
+
+// The prepared file the game looks for before an image: its path with ".pimg" appended
+std::string GetPreparedImageFile(std::string_view imageFile);
+
+// True if a file built from a source (a prepared image, a compiled story)
+// exists and is no older than the source, or exists and the source does not.
+// A stale build is skipped so edits show up before it is rebuilt.
+bool IsBuiltFileCurrent(const std::string& builtFile, const std::string& sourceFile);
+
+// Check the header of a prepared image file
+bool IsPreparedImageHeader(const PreparedImageHeader& header);
+
+// Write an image as a prepared image file
+bool SavePreparedImage(const std::string& filename, const PixelImage& image);
+
+#endif // PREPARED_IMAGE_H
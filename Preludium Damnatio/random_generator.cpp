@@ -0,0 +1,37 @@
+#include "random_generator.h"
+
+RandomGenerator::RandomGenerator(uint64_t seed) : state(seed) {}
+
+void RandomGenerator::Seed(uint64_t seed) {
+    state = seed;
+}
+
+uint64_t RandomGenerator::GetState() const {
+    return state;
+}
+
+void RandomGenerator::SetState(uint64_t state) {
+    this->state = state;
+}
+
+uint64_t RandomGenerator::Next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Lemire's multiply-shift: scale 32 random bits to the range and reject the
+// few values that would make some results more likely than others
+uint32_t RandomGenerator::NextBelow(uint32_t bound) {
+    uint64_t product = (Next() >> 32) * bound;
+    uint32_t low = static_cast<uint32_t>(product);
+    if (low < bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        while (low < threshold) {
+            product = (Next() >> 32) * bound;
+            low = static_cast<uint32_t>(product);
+        }
+    }
+    return static_cast<uint32_t>(product >> 32);
+}
@@ -0,0 +1,29 @@
+#ifndef RANDOM_GENERATOR_H
+#define RANDOM_GENERATOR_H
+
+#include <cstdint>
+
+// Small seedable pseudo-random generator (SplitMix64). Its whole state is one
+// 64-bit word, so each session can own one, save it with the game and replay
+// the same sequence of random events from the same seed.
+class RandomGenerator {
+public:
+    explicit RandomGenerator(uint64_t seed = 0);
+
+    void Seed(uint64_t seed);
+
+    // Raw state, for save files
+    uint64_t GetState() const;
+    void SetState(uint64_t state);
+
+    // Next 64 random bits
+    uint64_t Next();
+
+    // Uniform integer in [0, bound), without modulo bias (bound must be > 0)
+    uint32_t NextBelow(uint32_t bound);
+
+private:
+    uint64_t state;
+};
+
+#endif // RANDOM_GENERATOR_H
@@ -2,19 +2,43 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <sstream>
 
-// Constructor
-RenderManager::RenderManager(SDL_Renderer* renderer) : renderer(renderer), font(nullptr), initialized(renderer != nullptr) {
-    if (!renderer) {
-        std::cerr << "Failed to initialize RenderManager: Invalid renderer." << std::endl;
+namespace {
+    // Microseconds from start until now
+    double MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
     }
 }
 
+// Constructor
+RenderManager::RenderManager(SDL_Renderer* renderer) : renderer(renderer), lineBreaker(glyphAtlas), textureCache(renderer, &imageDecoder), sceneTarget(nullptr), sceneWidth(0), sceneHeight(0), sceneValid(false), drawingScene(false), frameTimings(), font(nullptr), fontSize(0), initialized(renderer != nullptr) {}
+
 // Destructor
 RenderManager::~RenderManager() {
+    Shutdown();
+}
+
+// Free the font and every texture; call before the renderer is destroyed
+void RenderManager::Shutdown() {
+    imageDecoder.Prefetch({}); // Cancel the decodes that have not started
+    shownImage.Reset();
+    textureCache.Clear();
+    if (sceneTarget) {
+        SDL_DestroyTexture(sceneTarget);
+        sceneTarget = nullptr;
+    }
+    sceneValid = false;
+    ReleaseFont();
+}
+
+// Close the font and drop everything built from it
+void RenderManager::ReleaseFont() {
+    textCache.Clear(); // Cached quads point into the atlas
+    lineBreaker.Clear(); // Word widths belong to the font
+    glyphAtlas.Release();
     if (font) {
         TTF_CloseFont(font);
+        font = nullptr;
     }
 }
 
@@ -30,101 +54,243 @@ TTF_Font* RenderManager::GetFont() const {
 
 // Clear the screen
 void RenderManager::Clear() {
+    if (!initialized) {
+        return; // Headless: nothing to clear
+    }
+    frameTimings = FrameTimings();
+    frameStart = std::chrono::steady_clock::now();
+    glyphAtlas.Discard(); // Anything queued before the clear would be cleared anyway
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Set color to black
     SDL_RenderClear(renderer); // Clear the screen
 }
 
 // Present the rendered content
 void RenderManager::Present() {
+    if (!initialized) {
+        return; // Headless: nothing to present
+    }
+    auto start = std::chrono::steady_clock::now();
+    FlushText();
     SDL_RenderPresent(renderer); // Present the rendered content
+    frameTimings.present += MicrosecondsSince(start);
+    frameTimings.total = MicrosecondsSince(frameStart);
+}
+
+// Where the time of the last frame went
+FrameTimings RenderManager::GetFrameTimings() const {
+    return frameTimings;
+}
+
+// Copy the retained scene to the screen if it is still current
+bool RenderManager::DrawRetainedScene() {
+    if (!initialized || !sceneValid) {
+        return false;
+    }
+    int width = 0;
+    int height = 0;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    if (width != sceneWidth || height != sceneHeight) {
+        return false; // Resized: the layout is drawn again at the new size
+    }
+    auto start = std::chrono::steady_clock::now();
+    FlushText();
+    SDL_RenderCopy(renderer, sceneTarget, nullptr, nullptr);
+    frameTimings.present += MicrosecondsSince(start);
+    return true;
+}
+
+// Redirect drawing into the scene texture, sized to the window
+void RenderManager::BeginScene() {
+    sceneValid = false;
+    if (!initialized || !SDL_RenderTargetSupported(renderer)) {
+        return; // Draw straight to the screen instead
+    }
+
+    int width = 0;
+    int height = 0;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    if (sceneTarget == nullptr || width != sceneWidth || height != sceneHeight) {
+        if (sceneTarget) {
+            SDL_DestroyTexture(sceneTarget);
+        }
+        sceneTarget = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (sceneTarget == nullptr) {
+            std::cerr << "Failed to create scene texture: " << SDL_GetError() << std::endl;
+            return;
+        }
+        SDL_SetTextureBlendMode(sceneTarget, SDL_BLENDMODE_NONE); // The scene covers the whole screen
+        sceneWidth = width;
+        sceneHeight = height;
+    }
+
+    FlushText(); // Queued text belongs on the screen, not in the scene
+    if (SDL_SetRenderTarget(renderer, sceneTarget) != 0) {
+        return;
+    }
+    drawingScene = true;
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+}
+
+// Finish the scene and copy it to the screen
+void RenderManager::EndScene() {
+    if (!drawingScene) {
+        return; // Drawn straight to the screen
+    }
+    auto start = std::chrono::steady_clock::now();
+    FlushText();
+    SDL_SetRenderTarget(renderer, nullptr);
+    drawingScene = false;
+    sceneValid = true;
+    SDL_RenderCopy(renderer, sceneTarget, nullptr, nullptr);
+    frameTimings.present += MicrosecondsSince(start);
+}
+
+// Rebuild the scene next time
+void RenderManager::InvalidateScene() {
+    sceneValid = false;
+}
+
+// The renderer lost every texture: rebuild them
+void RenderManager::RecreateTextures() {
+    shownImage.Reset(); // So the cache can drop it too
+    textureCache.Clear();
+    if (sceneTarget) {
+        SDL_DestroyTexture(sceneTarget);
+        sceneTarget = nullptr;
+    }
+    sceneValid = false;
+    textCache.Clear();
+    glyphAtlas.RecreateTexture();
+}
+
+// Draw the text queued so far
+void RenderManager::FlushText() {
+    glyphAtlas.Flush();
 }
 
 bool RenderManager::LoadFont(const std::string& fontPath, int fontSize) {
+    ReleaseFont(); // Drop the previous font and its glyphs
+    sceneValid = false; // Its text was drawn with the old font
     font = TTF_OpenFont(fontPath.c_str(), fontSize);
+    this->fontSize = fontSize;
     if (font == nullptr) {
         return false; // Return false if the font couldn't be loaded
     }
+
+    // Rasterize the glyphs once, up front
+    if (initialized && !glyphAtlas.Build(renderer, font)) {
+        return false;
+    }
     return true; // Return true if the font loaded successfully
 }
 
 
 
-void RenderManager::RenderTextToScreen(const std::string& text, int x, int y, SDL_Color color, int maxWidth, int* totalHeight) {
-    if (font == nullptr) {
-        return; // Exit if font is not loaded
+void RenderManager::RenderTextToScreen(std::string_view text, int x, int y, SDL_Color color, int maxWidth, int* totalHeight) {
+    if (font == nullptr || !initialized) {
+        return; // Exit if font is not loaded or there is no renderer
     }
+    auto start = std::chrono::steady_clock::now();
 
-    std::istringstream iss(text);
-    std::string word;
-    std::string line;
-    int initialY = y;
-    int lineHeight = TTF_FontHeight(font);
-
-    while (iss >> word) {
-        // Check if adding the word would exceed maxWidth
-        std::string newLine = line.empty() ? word : line + " " + word;
-        int newLineWidth;
-        TTF_SizeText(font, newLine.c_str(), &newLineWidth, nullptr);
-
-        if (newLineWidth > maxWidth && !line.empty()) {
-            // Render current line as texture if it would exceed maxWidth
-            SDL_Surface* lineSurface = TTF_RenderText_Solid(font, line.c_str(), color);
-            if (lineSurface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, lineSurface);
-                SDL_Rect dstRect = { x, y, lineSurface->w, lineSurface->h };
-                SDL_RenderCopy(renderer, texture, nullptr, &dstRect);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(lineSurface);
-            }
-
-            y += lineHeight; // Move down to start a new line
-            line = word; // Start a new line with the current word
-        }
-        else {
-            line = newLine; // Append word to the current line
-        }
+    // Text drawn before with the same font, color and width is already laid out
+    TextLayoutKey key = TextLayoutCache::MakeKey(text, font, fontSize, color, maxWidth);
+    const TextLayout* layout = textCache.Find(key, text);
+    if (layout == nullptr) {
+        layout = textCache.Insert(key, LayoutText(text, color, maxWidth));
     }
 
-    // Render any remaining text in the line buffer
-    if (!line.empty()) {
-        SDL_Surface* lineSurface = TTF_RenderText_Solid(font, line.c_str(), color);
-        if (lineSurface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, lineSurface);
-            SDL_Rect dstRect = { x, y, lineSurface->w, lineSurface->h };
-            SDL_RenderCopy(renderer, texture, nullptr, &dstRect);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(lineSurface);
-        }
-        y += lineHeight; // Account for the last rendered line
-    }
+    glyphAtlas.AddGeometry(layout->vertices, layout->indices, x, y);
 
     // Set total height if a pointer is passed
     if (totalHeight) {
-        *totalHeight = y - initialY; // Calculate the height of all rendered text
+        *totalHeight = layout->height; // The height of all rendered text
     }
+    frameTimings.text += MicrosecondsSince(start);
 }
 
+// Hits and misses of the text layout cache
+TextCacheStats RenderManager::GetTextCacheStats() const {
+    return textCache.GetStats();
+}
 
-void RenderManager::RenderImage(const std::string& filename, int x, int y, int width, int height) {
+// Wrap text to maxWidth and build its quads, with the top left corner at (0, 0)
+TextLayout RenderManager::LayoutText(std::string_view text, SDL_Color color, int maxWidth) {
+    TextLayout layout;
+    layout.text = std::string(text);
+    lineBreaker.Break(layout.text, maxWidth, layout.lines);
 
-    // Load image as surface
-    SDL_Surface* surface = SDL_LoadBMP(filename.c_str());
-    if (!surface) {
-        return; // Early exit if the image fails to load
+    // Words are drawn one by one at the positions the line breaker measured
+    int lineHeight = TTF_FontHeight(font);
+    int y = 0;
+    std::vector<PlacedWord> words;
+    for (const LineBreak& line : layout.lines) {
+        lineBreaker.PlaceWords(layout.text, line, words);
+        for (const PlacedWord& word : words) {
+            glyphAtlas.BuildText(std::string_view(layout.text).substr(word.start, word.end - word.start),
+                word.x, y, color, layout.vertices, layout.indices);
+        }
+        y += lineHeight;
     }
 
-    // Create texture from surface
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface); // Free the surface after creating the texture
-    if (!texture) {
-        return; // Early exit if texture creation fails
+    layout.height = y;
+    return layout;
+}
+
+
+void RenderManager::RenderImage(std::string_view filename, int x, int y, int width, int height) {
+    if (!initialized) {
+        return; // Headless: skip loading the image entirely
     }
 
-    SDL_Rect dstRect = { x, y, width, height }; // Destination rectangle for rendering
-    if (SDL_RenderCopy(renderer, texture, nullptr, &dstRect) != 0) {
+    FlushText(); // Keep text queued before the image underneath it
+    auto start = std::chrono::steady_clock::now();
+
+    // Loaded from disk only the first time (or after being evicted)
+    shownImage = textureCache.Acquire(filename);
+    if (shownImage) {
+        SDL_Rect dstRect = { x, y, width, height }; // Destination rectangle for rendering
+        SDL_RenderCopy(renderer, shownImage.Get(), nullptr, &dstRect);
     }
+    frameTimings.images += MicrosecondsSince(start);
+}
+
+// Bytes of image textures to keep resident
+void RenderManager::SetTextureBudget(size_t bytes) {
+    textureCache.SetBudget(bytes);
+}
+
+// How far each image is from the current node
+void RenderManager::SetImageDistances(const std::vector<ImageDistance>& distances) {
+    textureCache.SetDistances(distances);
+}
 
-    SDL_DestroyTexture(texture); // Clean up the texture
+// Image textures at most this many choices away are kept whatever the budget
+void RenderManager::SetImageKeepDistance(int hops) {
+    textureCache.SetKeepDistance(hops);
 }
 
+// Hits, misses and residency of the image texture cache
+TextureCacheStats RenderManager::GetTextureCacheStats() const {
+    return textureCache.GetStats();
+}
+
+// Decode the images that may be shown next in the background
+void RenderManager::PrefetchImages(const std::vector<std::string_view>& files) {
+    if (!initialized) {
+        return; // Headless: images are never shown
+    }
+
+    std::vector<std::string_view> missing;
+    for (std::string_view file : files) {
+        if (!file.empty() && !textureCache.IsResident(file)) {
+            missing.push_back(file);
+        }
+    }
+    imageDecoder.Prefetch(missing);
+}
 
+// Prefetch hits and wasted decodes of the background image decoder
+ImageDecodeStats RenderManager::GetImageDecodeStats() const {
+    return imageDecoder.GetStats();
+}
@@ -1,24 +1,60 @@
 #ifndef RENDER_MANAGER_H
 #define RENDER_MANAGER_H
 
+#include "glyph_atlas.h"
+#include "image_decoder.h"
+#include "line_breaker.h"
+#include "text_layout_cache.h"
+#include "texture_cache.h"
+#include <chrono>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <SDL.h>
 #include <SDL_ttf.h>
 
+// CPU time spent drawing one frame, in microseconds
+struct FrameTimings {
+    double text;    // Laying out and queueing text
+    double images;  // Loading and drawing images
+    double present; // Flushing the queued text, copying the scene and presenting
+    double total;   // From Clear to the end of Present
+};
+
 class RenderManager {
 public:
-    // Constructor
+    // Constructor (a null renderer gives a manager that draws nothing, for headless runs)
     RenderManager(SDL_Renderer* renderer);
 
     // Destructor
     ~RenderManager();
 
-    // Clear the screen
+    // Clear the screen; this starts a new frame for GetFrameTimings
     void Clear();
 
     // Present the rendered content
     void Present();
 
+    // Free the font and every texture; call before the renderer is destroyed
+    void Shutdown();
+
+    // A whole screen is drawn once into an offscreen texture and copied on
+    // later frames. If the scene is still valid and the window has the same
+    // size, DrawRetainedScene copies it to the screen and returns true.
+    // Otherwise draw the screen between BeginScene and EndScene, which
+    // redirect drawing into the texture and then copy it to the screen.
+    bool DrawRetainedScene();
+    void BeginScene();
+    void EndScene();
+
+    // The screen content changed (or the GPU lost the texture): rebuild the scene next time
+    void InvalidateScene();
+
+    // The renderer lost every texture (SDL_RENDER_DEVICE_RESET): upload the
+    // glyph atlas again and drop the image textures and the scene, which are
+    // recreated as they are drawn
+    void RecreateTextures();
+
     // Load and set the font
     bool LoadFont(const std::string& fontPath, int fontSize);
 
@@ -27,15 +63,65 @@ public:
     // Check if RenderManager is initialized
     bool IsInitialized() const;
 
-    // Render text to SDL window with optional width for wrapping and total height calculation
-    void RenderTextToScreen(const std::string& text, int x, int y, SDL_Color color = { 255, 255, 255, 255 }, int maxWidth = 780, int* totalHeight = nullptr);
+    // Render text to SDL window with optional width for wrapping and total height calculation.
+    // Text is queued in the glyph atlas and drawn in one batch by the next Present (or image).
+    void RenderTextToScreen(std::string_view text, int x, int y, SDL_Color color = { 255, 255, 255, 255 }, int maxWidth = 780, int* totalHeight = nullptr);
+
+    // Where the time of the last frame went (complete once Present returns)
+    FrameTimings GetFrameTimings() const;
+
+    // Hits and misses of the text layout cache
+    TextCacheStats GetTextCacheStats() const;
+
+    // Load and render an image. Images stay cached as textures between calls.
+    void RenderImage(std::string_view filename, int x, int y, int width, int height);
 
-    // Load and render an image
-    void RenderImage(const std::string& filename, int x, int y, int width, int height);
+    // Bytes of image textures to keep resident (4 bytes per pixel)
+    void SetTextureBudget(size_t bytes);
+
+    // How far each image is from the current node; distant textures are evicted first
+    void SetImageDistances(const std::vector<ImageDistance>& distances);
+
+    // Image textures at most this many choices away are kept whatever the budget
+    void SetImageKeepDistance(int hops);
+
+    // Hits, misses and residency of the image texture cache
+    TextureCacheStats GetTextureCacheStats() const;
+
+    // Decode the images that may be shown next in the background, dropping
+    // those of the previous call that were not shown. Images already
+    // resident as textures are skipped.
+    void PrefetchImages(const std::vector<std::string_view>& files);
+
+    // Prefetch hits and wasted decodes of the background image decoder
+    ImageDecodeStats GetImageDecodeStats() const;
 
 private:
+    // Draw the text queued so far, so it stays under anything drawn after it
+    void FlushText();
+
+    // Close the font and drop everything built from it
+    void ReleaseFont();
+
+    // Wrap text to maxWidth and build its quads, with the top left corner at (0, 0)
+    TextLayout LayoutText(std::string_view text, SDL_Color color, int maxWidth);
+
     SDL_Renderer* renderer; // Pointer to the SDL renderer
+    GlyphAtlas glyphAtlas; // Every glyph of the font, rasterized once
+    LineBreaker lineBreaker; // Word-wraps text, caching word widths for the font
+    TextLayoutCache textCache; // Wrapped text, ready to queue again
+    ImageDecoder imageDecoder; // Decodes the images of the next nodes ahead of time
+    TextureCache textureCache; // Node images, kept as textures
+    TextureHandle shownImage; // Image drawn last, never evicted while it is on screen
+    SDL_Texture* sceneTarget; // The last full screen drawn, or nullptr
+    int sceneWidth; // Size of sceneTarget
+    int sceneHeight;
+    bool sceneValid; // sceneTarget holds the current screen
+    bool drawingScene; // Between BeginScene and EndScene with sceneTarget as the target
+    FrameTimings frameTimings; // Of the frame being drawn
+    std::chrono::steady_clock::time_point frameStart; // When Clear started it
     TTF_Font* font; // Pointer to the loaded font
+    int fontSize; // Point size the font was loaded at
     bool initialized; // Flag to check if RenderManager is initialized
 };
 
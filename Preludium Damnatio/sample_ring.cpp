@@ -0,0 +1,57 @@
+#include "sample_ring.h"
+#include <algorithm>
+#include <cstring>
+
+SampleRing::SampleRing(size_t capacity)
+    : written(0), read(0)
+{
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+// Writer: copy in as many samples as fit, returning how many did
+size_t SampleRing::Write(const int16_t* samples, size_t count) {
+    size_t writeCount = written.load(std::memory_order_relaxed);
+    size_t readCount = read.load(std::memory_order_acquire);
+    count = std::min(count, buffer.size() - (writeCount - readCount));
+
+    // The free space may wrap around the end of the buffer
+    size_t start = writeCount & mask;
+    size_t first = std::min(count, buffer.size() - start);
+    std::memcpy(buffer.data() + start, samples, first * sizeof(int16_t));
+    std::memcpy(buffer.data(), samples + first, (count - first) * sizeof(int16_t));
+
+    written.store(writeCount + count, std::memory_order_release);
+    return count;
+}
+
+// Reader: copy out as many samples as are there, returning how many were
+size_t SampleRing::Read(int16_t* samples, size_t count) {
+    size_t readCount = read.load(std::memory_order_relaxed);
+    size_t writeCount = written.load(std::memory_order_acquire);
+    count = std::min(count, writeCount - readCount);
+
+    size_t start = readCount & mask;
+    size_t first = std::min(count, buffer.size() - start);
+    std::memcpy(samples, buffer.data() + start, first * sizeof(int16_t));
+    std::memcpy(samples + first, buffer.data(), (count - first) * sizeof(int16_t));
+
+    read.store(readCount + count, std::memory_order_release);
+    return count;
+}
+
+size_t SampleRing::GetSpace() const {
+    return buffer.size() - (written.load(std::memory_order_relaxed) - read.load(std::memory_order_acquire));
+}
+
+size_t SampleRing::GetAvailable() const {
+    return written.load(std::memory_order_acquire) - read.load(std::memory_order_relaxed);
+}
+
+size_t SampleRing::GetCapacity() const {
+    return buffer.size();
+}
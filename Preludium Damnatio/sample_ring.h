@@ -0,0 +1,39 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed size ring of audio samples shared by exactly two threads: one only
+// writes and the other only reads. Neither side ever locks or waits, so the
+// audio callback can read from it while a reader thread fills it from disk.
+class SampleRing {
+public:
+    explicit SampleRing(size_t capacity); // Rounded up to a power of two
+
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+
+    // Writer: copy in as many samples as fit, returning how many did
+    size_t Write(const int16_t* samples, size_t count);
+
+    // Reader: copy out as many samples as are there, returning how many were
+    size_t Read(int16_t* samples, size_t count);
+
+    size_t GetSpace() const;     // Samples the writer can add
+    size_t GetAvailable() const; // Samples the reader can take
+    size_t GetCapacity() const;
+
+private:
+    std::vector<int16_t> buffer;
+    size_t mask;
+
+    // Free-running counts of samples written and read; each is stored only by
+    // its own side. Kept on separate cache lines so the sides do not contend.
+    alignas(64) std::atomic<size_t> written;
+    alignas(64) std::atomic<size_t> read;
+};
+
+#endif // SAMPLE_RING_H
@@ -0,0 +1,123 @@
+#include "save_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    // Write a whole file and flush it to the disk
+    bool WriteAndSync(const std::string& filename, const void* data, size_t size) {
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        const char* bytes = static_cast<const char*>(data);
+        bool written = true;
+        while (size > 0 && written) {
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD done = 0;
+            written = WriteFile(file, bytes, chunk, &done, nullptr) && done == chunk;
+            bytes += done;
+            size -= done;
+        }
+        written = written && FlushFileBuffers(file);
+        CloseHandle(file);
+        return written;
+    }
+#else
+    // Write a whole file and flush it to the disk
+    bool WriteAndSync(const std::string& filename, const void* data, size_t size) {
+        int file = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (file < 0) {
+            return false;
+        }
+
+        const char* bytes = static_cast<const char*>(data);
+        bool written = true;
+        while (size > 0 && written) {
+            ssize_t done = write(file, bytes, size);
+            if (done < 0 && errno == EINTR) {
+                continue;
+            }
+            written = done > 0;
+            if (written) {
+                bytes += done;
+                size -= static_cast<size_t>(done);
+            }
+        }
+        written = written && fsync(file) == 0;
+        return close(file) == 0 && written;
+    }
+
+    // Flush the directory too, or the rename itself may not survive a power loss
+    void SyncDirectory(const std::string& filename) {
+        std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+        int handle = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_CLOEXEC);
+        if (handle >= 0) {
+            fsync(handle);
+            close(handle);
+        }
+    }
+#endif
+}
+
+// Write to a temporary file, sync it and rename it over the target
+bool WriteFileAtomically(const std::string& filename, const void* data, size_t size) {
+    std::string tempName = filename + ".tmp";
+    if (!WriteAndSync(tempName, data, size)) {
+        std::cerr << "Failed to write save file: " << tempName << std::endl;
+        std::remove(tempName.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    bool renamed = MoveFileExA(tempName.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool renamed = std::rename(tempName.c_str(), filename.c_str()) == 0;
+#endif
+    if (!renamed) {
+        std::cerr << "Failed to replace save file: " << filename << std::endl;
+        std::remove(tempName.c_str());
+        return false;
+    }
+#ifndef _WIN32
+    SyncDirectory(filename);
+#endif
+    return true;
+}
+
+bool ReadWholeFile(const std::string& filename, std::vector<uint8_t>& buffer) {
+    std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+
+    std::streamoff size = file.tellg();
+    if (size < 0) {
+        return false;
+    }
+    buffer.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), size);
+    return static_cast<bool>(file);
+}
+
+bool RemoveFile(const std::string& filename) {
+    if (std::remove(filename.c_str()) == 0) {
+        return true;
+    }
+    std::ifstream file(filename);
+    return !file; // Nothing to remove
+}
@@ -0,0 +1,20 @@
+#ifndef SAVE_FILE_H
+#define SAVE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Write a whole file to "<filename>.tmp", flush it to the disk and rename it
+// over filename, so a crash or power loss mid-write leaves either the old
+// file or the new one, never a truncated save
+bool WriteFileAtomically(const std::string& filename, const void* data, size_t size);
+
+// Read a whole file into buffer, reusing its capacity
+bool ReadWholeFile(const std::string& filename, std::vector<uint8_t>& buffer);
+
+// Delete a file; returns true if it is gone (or never existed)
+bool RemoveFile(const std::string& filename);
+
+#endif // SAVE_FILE_H
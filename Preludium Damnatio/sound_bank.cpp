@@ -0,0 +1,125 @@
+#include "sound_bank.h"
+#include "audio_convert.h"
+#include <algorithm>
+#include <iostream>
+#include <SDL.h>
+
+// Decode a sound into the bank unless it is already there
+int SoundBank::Load(const std::string& file) {
+    if (Contains(file)) {
+        return Find(file); // Loaded before, or failed before
+    }
+
+    std::vector<int16_t> samples;
+    if (!Decode(file, samples)) {
+        samples.clear();
+    }
+    Reserve(samples.size());
+    Add(file, samples);
+    return Find(file);
+}
+
+// Load many sounds at once, growing the arena only once
+void SoundBank::LoadAll(const std::vector<std::string>& files) {
+    std::vector<std::string> newFiles;
+    std::vector<std::vector<int16_t>> decoded;
+    size_t total = 0;
+    for (const std::string& file : files) {
+        if (Contains(file) || std::find(newFiles.begin(), newFiles.end(), file) != newFiles.end()) {
+            continue;
+        }
+        newFiles.push_back(file);
+        decoded.emplace_back();
+        if (!Decode(file, decoded.back())) {
+            decoded.back().clear();
+        }
+        total += decoded.back().size();
+    }
+
+    Reserve(total);
+    for (size_t i = 0; i < newFiles.size(); ++i) {
+        Add(newFiles[i], decoded[i]);
+    }
+}
+
+// The id of a loaded sound, or NoSound
+int SoundBank::Find(std::string_view file) const {
+    size_t index = LowerBound(file);
+    if (index == sortedIds.size()) {
+        return NoSound;
+    }
+    const Sound& sound = sounds[sortedIds[index]];
+    return sound.file == file && sound.frames > 0 ? sortedIds[index] : NoSound;
+}
+
+// The samples of a sound, for the mixer
+AudioClip SoundBank::GetClip(int sound) const {
+    AudioClip clip;
+    if (sound >= 0 && static_cast<size_t>(sound) < sounds.size() && sounds[sound].frames > 0) {
+        clip.samples = arena.data() + sounds[sound].offset;
+        clip.frames = sounds[sound].frames;
+    }
+    return clip;
+}
+
+size_t SoundBank::GetSoundCount() const {
+    return sounds.size();
+}
+
+size_t SoundBank::GetArenaBytes() const {
+    return arena.size() * sizeof(int16_t);
+}
+
+// Decode a WAV file into the mixer's format
+bool SoundBank::Decode(const std::string& file, std::vector<int16_t>& samples) {
+    SDL_AudioSpec spec;
+    Uint8* buffer = nullptr;
+    Uint32 length = 0;
+    if (SDL_LoadWAV(file.c_str(), &spec, &buffer, &length) == nullptr) {
+        std::cerr << "Failed to load audio: " << file << " SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    bool converted = ConvertAudio(buffer, length, spec.format, spec.channels, spec.freq, samples);
+    SDL_FreeWAV(buffer);
+    if (!converted) {
+        std::cerr << "Unsupported audio format: " << file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Make room for more samples in the arena, keeping the old one if it moves
+void SoundBank::Reserve(size_t samples) {
+    if (arena.capacity() - arena.size() >= samples) {
+        return;
+    }
+    std::vector<int16_t> grown;
+    grown.reserve(std::max(arena.size() + samples, arena.capacity() * 2));
+    grown.insert(grown.end(), arena.begin(), arena.end());
+    if (!arena.empty()) {
+        retired.push_back(std::move(arena));
+    }
+    arena = std::move(grown);
+}
+
+// Append decoded samples to the arena and record the sound
+void SoundBank::Add(const std::string& file, const std::vector<int16_t>& samples) {
+    int id = static_cast<int>(sounds.size());
+    sounds.push_back({ file, arena.size(), samples.size() / AudioMixer::Channels });
+    arena.insert(arena.end(), samples.begin(), samples.end());
+    sortedIds.insert(sortedIds.begin() + LowerBound(file), id);
+}
+
+// The file has been loaded, or has failed to
+bool SoundBank::Contains(std::string_view file) const {
+    size_t index = LowerBound(file);
+    return index < sortedIds.size() && sounds[sortedIds[index]].file == file;
+}
+
+// Position of the first sound whose file does not sort before file
+size_t SoundBank::LowerBound(std::string_view file) const {
+    auto found = std::lower_bound(sortedIds.begin(), sortedIds.end(), file,
+        [this](int id, std::string_view name) { return std::string_view(sounds[id].file) < name; });
+    return static_cast<size_t>(found - sortedIds.begin());
+}
@@ -0,0 +1,64 @@
+#ifndef SOUND_BANK_H
+#define SOUND_BANK_H
+
+#include "audio_mixer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Short sounds (the story's node effects) decoded once and kept in the
+// mixer's format, one after another in a single arena. Playing one is a
+// lookup and a voice assignment: no file access, conversion or allocation.
+class SoundBank {
+public:
+    static const int NoSound = -1;
+
+    // Decode a sound into the bank unless it is already there. Returns its
+    // id, or NoSound if it cannot be loaded (which is also remembered).
+    int Load(const std::string& file);
+
+    // Load many sounds at once, growing the arena only once
+    void LoadAll(const std::vector<std::string>& files);
+
+    // The file has been loaded, or has failed to
+    bool Contains(std::string_view file) const;
+
+    // The id of a loaded sound, or NoSound; does not allocate
+    int Find(std::string_view file) const;
+
+    // The samples of a sound, for the mixer; empty for NoSound
+    AudioClip GetClip(int sound) const;
+
+    size_t GetSoundCount() const;
+    size_t GetArenaBytes() const;
+
+private:
+    struct Sound {
+        std::string file;
+        size_t offset; // First sample in the arena
+        size_t frames; // 0 if the file failed to load
+    };
+
+    // Decode a file into the mixer's format
+    static bool Decode(const std::string& file, std::vector<int16_t>& samples);
+
+    // Make room for more samples in the arena. If it has to move, the old
+    // one is kept, since voices may be playing from it.
+    void Reserve(size_t samples);
+
+    // Append decoded samples to the arena and record the sound
+    void Add(const std::string& file, const std::vector<int16_t>& samples);
+
+    // Position in sortedIds of the first sound whose file does not sort before file
+    size_t LowerBound(std::string_view file) const;
+
+    std::vector<Sound> sounds;    // Indexed by id
+    std::vector<int> sortedIds;   // For Find
+    std::vector<int16_t> arena;   // Every sound's samples
+    // Arenas outgrown by a later Load; voices may still be playing from them
+    std::vector<std::vector<int16_t>> retired;
+};
+
+#endif // SOUND_BANK_H
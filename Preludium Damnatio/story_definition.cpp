@@ -0,0 +1,89 @@
+#include "story_definition.h"
+#include "story_loader.h"
+#include <iostream>
+
+StoryDefinition::StoryDefinition()
+    : startNode(StoryGraph::InvalidNode),
+    endNode(StoryGraph::InvalidNode),
+    encounterNode(StoryGraph::InvalidNode)
+{
+}
+
+// Load a story file and find the nodes sessions need
+bool StoryDefinition::Load(const std::string& storyFile) {
+    startNode = StoryGraph::InvalidNode;
+
+    // Compiled stories are mapped and used in place; text stories are parsed
+    StoryLoader loader;
+    if (!loader.Open(storyFile, graph)) {
+        return false;
+    }
+
+    // Intern the end and random encounter markers and find the "start" node
+    endNode = graph.InternNode("end_game");
+    encounterNode = graph.InternNode("random_encounter");
+    encounters.Build(graph);
+    startNode = graph.FindNode("start");
+    if (!graph.IsDefined(startNode)) {
+        std::cerr << "Story has no start node: " << storyFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const StoryGraph& StoryDefinition::GetGraph() const {
+    return graph;
+}
+
+const EncounterTable& StoryDefinition::GetEncounters() const {
+    return encounters;
+}
+
+int StoryDefinition::GetStartNode() const {
+    return startNode;
+}
+
+int StoryDefinition::GetEndNode() const {
+    return endNode;
+}
+
+int StoryDefinition::GetEncounterNode() const {
+    return encounterNode;
+}
+
+// Fewest choices from a node to every node, breadth first
+void StoryDefinition::FindDistances(int from, std::vector<int>& distances, std::vector<int>& queue) const {
+    distances.assign(graph.GetNodeCount(), -1);
+    queue.clear();
+    if (!graph.IsDefined(from)) {
+        return;
+    }
+
+    distances[from] = 0;
+    queue.push_back(from);
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int node = queue[head];
+        int choiceCount = graph.GetChoiceCount(node);
+        for (int choice = 0; choice < choiceCount; ++choice) {
+            int next = graph.GetNextNode(node, choice);
+            if (next == encounterNode) {
+                // Any encounter may come up; they are all one choice away
+                if (distances[next] >= 0) {
+                    continue; // Reached earlier, so no later than now
+                }
+                distances[next] = distances[node] + 1;
+                for (int encounter = 0; encounter < encounters.GetCount(); ++encounter) {
+                    int encounterTarget = encounters.GetNode(encounter);
+                    if (distances[encounterTarget] < 0) {
+                        distances[encounterTarget] = distances[node] + 1;
+                        queue.push_back(encounterTarget);
+                    }
+                }
+            }
+            else if (graph.IsDefined(next) && distances[next] < 0) {
+                distances[next] = distances[node] + 1;
+                queue.push_back(next);
+            }
+        }
+    }
+}
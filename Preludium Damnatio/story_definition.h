@@ -0,0 +1,42 @@
+#ifndef STORY_DEFINITION_H
+#define STORY_DEFINITION_H
+
+#include "story_graph.h"
+#include "encounter_table.h"
+#include <string>
+#include <vector>
+
+// A loaded story and the lookups every player of it needs: the graph, its
+// random encounter table and the start and marker nodes. It is not changed
+// after Load, so one definition can be shared by any number of sessions on
+// any number of threads.
+class StoryDefinition {
+public:
+    StoryDefinition();
+
+    StoryDefinition(const StoryDefinition&) = delete;
+    StoryDefinition& operator=(const StoryDefinition&) = delete;
+
+    // Load a story file (.story text or .storyc compiled); fails if it has no "start" node
+    bool Load(const std::string& storyFile);
+
+    const StoryGraph& GetGraph() const;
+    const EncounterTable& GetEncounters() const;
+    int GetStartNode() const;     // The "start" node
+    int GetEndNode() const;       // The "end_game" marker node
+    int GetEncounterNode() const; // The "random_encounter" marker node
+
+    // Fewest choices from a node to every node (-1 where it cannot be reached),
+    // over every transition whatever its condition; a choice leading to
+    // random_encounter reaches every encounter. queue is scratch space.
+    void FindDistances(int from, std::vector<int>& distances, std::vector<int>& queue) const;
+
+private:
+    StoryGraph graph;
+    EncounterTable encounters; // Random encounter nodes of the story
+    int startNode;
+    int endNode;
+    int encounterNode;
+};
+
+#endif // STORY_DEFINITION_H
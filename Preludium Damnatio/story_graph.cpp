@@ -0,0 +1,463 @@
+#include "story_graph.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+namespace {
+    const char FileMagic[4] = { 'P', 'D', 'S', 'T' };
+    const uint32_t InitialNameTableSize = 64;
+
+    // FNV-1a hash of a node name
+    uint32_t HashName(std::string_view name) {
+        uint32_t hash = 2166136261u;
+        for (char c : name) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+}
+
+// Empty every field but keep the allocated capacity for reuse
+void StoryNode::Clear() {
+    text.clear();
+    options.clear();
+    nextNodes.clear();
+    asciiArt.clear();
+    audioFile.clear();
+    musicFile.clear();
+    imageFile.clear();
+    encounterWeight = 0;
+    optionScripts.clear();
+    scriptCode.clear();
+}
+
+StoryGraph::StoryGraph() {
+    Clear();
+}
+
+// Return the index for a node name, assigning a new one if it has not been seen
+int StoryGraph::InternNode(std::string_view name) {
+    int index = FindNode(name);
+    if (index != InvalidNode || mappedFile.GetData() != nullptr) {
+        return index; // Known already, or a read-only mapped story
+    }
+
+    if ((ownedNodes.size() + 1) * 2 > ownedNameTable.size()) {
+        GrowNameTable();
+    }
+
+    index = static_cast<int>(ownedNodes.size());
+    StoryNodeRecord record = {};
+    record.name = AddString(name);
+    ownedNodes.push_back(record);
+
+    uint32_t mask = static_cast<uint32_t>(ownedNameTable.size()) - 1;
+    uint32_t slot = HashName(name) & mask;
+    while (ownedNameTable[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    ownedNameTable[slot] = static_cast<uint32_t>(index) + 1;
+
+    BindOwnedTables();
+    return index;
+}
+
+// Look up a node index by name
+int StoryGraph::FindNode(std::string_view name) const {
+    if (nameTableSize == 0) {
+        return InvalidNode;
+    }
+
+    uint32_t mask = nameTableSize - 1;
+    for (uint32_t slot = HashName(name) & mask; nameTable[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t index = nameTable[slot] - 1;
+        if (GetString(nodes[index].name) == name) {
+            return static_cast<int>(index);
+        }
+    }
+    return InvalidNode;
+}
+
+// Define a node by packing an authored node into the graph's tables
+int StoryGraph::AddNode(std::string_view name, const StoryNode& node) {
+    int index = InternNode(name);
+    if (index == InvalidNode || mappedFile.GetData() != nullptr) {
+        return InvalidNode; // Mapped stories are read-only
+    }
+
+    // Intern the targets first, since that may append records for nodes not seen yet
+    uint32_t firstTransition = static_cast<uint32_t>(ownedTransitions.size());
+    for (const auto& next : node.nextNodes) {
+        ownedTransitions.push_back(static_cast<uint32_t>(InternNode(next.second)));
+    }
+
+    uint32_t firstOption = static_cast<uint32_t>(ownedOptions.size());
+    for (const auto& option : node.options) {
+        ownedOptions.push_back(AddString(option));
+    }
+
+    // Move the node's scripts into the shared code table (jumps are relative, so only the offsets change)
+    uint32_t codeBase = static_cast<uint32_t>(ownedCode.size());
+    ownedCode.insert(ownedCode.end(), node.scriptCode.begin(), node.scriptCode.end());
+    for (size_t option = 0; option < node.options.size(); ++option) {
+        StoryOptionScript script = { NoScript, NoScript };
+        if (option < node.optionScripts.size()) {
+            script = node.optionScripts[option];
+            if (script.condition != NoScript) {
+                script.condition += codeBase;
+            }
+            if (script.effect != NoScript) {
+                script.effect += codeBase;
+            }
+        }
+        ownedOptionScripts.push_back(script);
+    }
+
+    StoryNodeRecord& record = ownedNodes[index];
+    record.text = AddString(node.text);
+    record.asciiArt = AddString(node.asciiArt);
+    record.audioFile = AddString(node.audioFile);
+    record.musicFile = AddString(node.musicFile);
+    record.imageFile = AddString(node.imageFile);
+    record.firstOption = firstOption;
+    record.optionCount = static_cast<uint32_t>(node.options.size());
+    record.firstTransition = firstTransition;
+    record.transitionCount = static_cast<uint32_t>(node.nextNodes.size());
+    record.flags |= StoryNodeDefined;
+    record.encounterWeight = node.encounterWeight;
+
+    BindOwnedTables();
+    return index;
+}
+
+// Declare a story variable
+int StoryGraph::AddVariable(std::string_view name, int32_t initialValue) {
+    if (FindVariable(name) >= 0 || mappedFile.GetData() != nullptr) {
+        return -1;
+    }
+    ownedVariables.push_back({ AddString(name), initialValue });
+    BindOwnedTables();
+    return static_cast<int>(ownedVariables.size()) - 1;
+}
+
+// Look up a variable by name (stories have few variables, and this only runs while loading)
+int StoryGraph::FindVariable(std::string_view name) const {
+    for (uint32_t variable = 0; variable < variableCount; ++variable) {
+        if (GetString(variables[variable].name) == name) {
+            return static_cast<int>(variable);
+        }
+    }
+    return -1;
+}
+
+int StoryGraph::GetVariableCount() const {
+    return static_cast<int>(variableCount);
+}
+
+std::string_view StoryGraph::GetVariableName(int variable) const {
+    return GetString(variables[variable].name);
+}
+
+int32_t StoryGraph::GetVariableInitialValue(int variable) const {
+    return variables[variable].initialValue;
+}
+
+// Remove all nodes and release any mapped file
+void StoryGraph::Clear() {
+    mappedFile.Close();
+    ownedNodes.clear();
+    ownedOptions.clear();
+    ownedOptionScripts.clear();
+    ownedCode.clear();
+    ownedTransitions.clear();
+    ownedNameTable.clear();
+    ownedVariables.clear();
+    ownedStrings.clear();
+    BindOwnedTables();
+}
+
+// Write the graph as a compiled story file (native little-endian layout)
+bool StoryGraph::SaveCompiled(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not create compiled story: " << filename << std::endl;
+        return false;
+    }
+
+    StoryFileHeader header = {};
+    std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.nodeCount = nodeCount;
+    header.optionCount = optionCount;
+    header.transitionCount = transitionCount;
+    header.nameTableSize = nameTableSize;
+    header.stringPoolSize = stringPoolSize;
+    header.variableCount = variableCount;
+    header.instructionCount = instructionCount;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(nodes), sizeof(StoryNodeRecord) * nodeCount);
+    file.write(reinterpret_cast<const char*>(options), sizeof(StoryString) * optionCount);
+    file.write(reinterpret_cast<const char*>(optionScripts), sizeof(StoryOptionScript) * optionCount);
+    file.write(reinterpret_cast<const char*>(code), sizeof(StoryInstruction) * instructionCount);
+    file.write(reinterpret_cast<const char*>(transitions), sizeof(uint32_t) * transitionCount);
+    file.write(reinterpret_cast<const char*>(nameTable), sizeof(uint32_t) * nameTableSize);
+    file.write(reinterpret_cast<const char*>(variables), sizeof(StoryVariable) * variableCount);
+    file.write(strings, stringPoolSize);
+
+    if (!file) {
+        std::cerr << "Failed to write compiled story: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Map a compiled story file and use its tables in place
+bool StoryGraph::OpenCompiled(const std::string& filename) {
+    Clear();
+
+    if (!mappedFile.Open(filename)) {
+        std::cerr << "Could not open compiled story: " << filename << std::endl;
+        return false;
+    }
+
+    const char* data = mappedFile.GetData();
+    size_t size = mappedFile.GetSize();
+    StoryFileHeader header;
+    if (size < sizeof(header)) {
+        std::cerr << "Compiled story is truncated: " << filename << std::endl;
+        Clear();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0 || header.version != FileVersion) {
+        std::cerr << "Not a compiled story (or wrong version): " << filename << std::endl;
+        Clear();
+        return false;
+    }
+
+    // The table sizes must add up to the file size before the tables are looked at
+    unsigned long long expectedSize = sizeof(header)
+        + static_cast<unsigned long long>(header.nodeCount) * sizeof(StoryNodeRecord)
+        + static_cast<unsigned long long>(header.optionCount) * (sizeof(StoryString) + sizeof(StoryOptionScript))
+        + static_cast<unsigned long long>(header.instructionCount) * sizeof(StoryInstruction)
+        + static_cast<unsigned long long>(header.transitionCount) * sizeof(uint32_t)
+        + static_cast<unsigned long long>(header.nameTableSize) * sizeof(uint32_t)
+        + static_cast<unsigned long long>(header.variableCount) * sizeof(StoryVariable)
+        + header.stringPoolSize;
+    bool nameTableValid = header.nameTableSize == 0 || (header.nameTableSize & (header.nameTableSize - 1)) == 0;
+    if (expectedSize != size || !nameTableValid) {
+        std::cerr << "Compiled story is corrupt: " << filename << std::endl;
+        Clear();
+        return false;
+    }
+
+    const char* cursor = data + sizeof(header);
+    nodes = reinterpret_cast<const StoryNodeRecord*>(cursor);
+    cursor += sizeof(StoryNodeRecord) * header.nodeCount;
+    options = reinterpret_cast<const StoryString*>(cursor);
+    cursor += sizeof(StoryString) * header.optionCount;
+    optionScripts = reinterpret_cast<const StoryOptionScript*>(cursor);
+    cursor += sizeof(StoryOptionScript) * header.optionCount;
+    code = reinterpret_cast<const StoryInstruction*>(cursor);
+    cursor += sizeof(StoryInstruction) * header.instructionCount;
+    transitions = reinterpret_cast<const uint32_t*>(cursor);
+    cursor += sizeof(uint32_t) * header.transitionCount;
+    nameTable = reinterpret_cast<const uint32_t*>(cursor);
+    cursor += sizeof(uint32_t) * header.nameTableSize;
+    variables = reinterpret_cast<const StoryVariable*>(cursor);
+    cursor += sizeof(StoryVariable) * header.variableCount;
+    strings = cursor;
+
+    nodeCount = header.nodeCount;
+    optionCount = header.optionCount;
+    transitionCount = header.transitionCount;
+    nameTableSize = header.nameTableSize;
+    variableCount = header.variableCount;
+    instructionCount = header.instructionCount;
+    stringPoolSize = header.stringPoolSize;
+
+    // One pass over the tables, so the accessors can index them without checks
+    if (!ValidateTables()) {
+        std::cerr << "Compiled story is corrupt: " << filename << std::endl;
+        Clear();
+        return false;
+    }
+    return true;
+}
+
+int StoryGraph::GetNodeCount() const {
+    return static_cast<int>(nodeCount);
+}
+
+// 64-bit FNV-1a over every node name and then every variable name, each followed by a zero byte
+uint64_t StoryGraph::GetFingerprint() const {
+    uint64_t hash = 14695981039346656037ull;
+    auto addName = [&hash](std::string_view name) {
+        for (char c : name) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        hash *= 1099511628211ull;
+    };
+    for (uint32_t index = 0; index < nodeCount; ++index) {
+        addName(GetString(nodes[index].name));
+    }
+    for (uint32_t variable = 0; variable < variableCount; ++variable) {
+        addName(GetString(variables[variable].name));
+    }
+    return hash;
+}
+
+bool StoryGraph::IsDefined(int index) const {
+    return index >= 0 && static_cast<uint32_t>(index) < nodeCount && (nodes[index].flags & StoryNodeDefined) != 0;
+}
+
+std::string_view StoryGraph::GetNodeName(int index) const {
+    return GetString(nodes[index].name);
+}
+
+std::string_view StoryGraph::GetText(int index) const {
+    return GetString(nodes[index].text);
+}
+
+std::string_view StoryGraph::GetAsciiArt(int index) const {
+    return GetString(nodes[index].asciiArt);
+}
+
+std::string_view StoryGraph::GetAudioFile(int index) const {
+    return GetString(nodes[index].audioFile);
+}
+
+std::string_view StoryGraph::GetMusicFile(int index) const {
+    return GetString(nodes[index].musicFile);
+}
+
+std::string_view StoryGraph::GetImageFile(int index) const {
+    return GetString(nodes[index].imageFile);
+}
+
+int StoryGraph::GetOptionCount(int index) const {
+    return static_cast<int>(nodes[index].optionCount);
+}
+
+std::string_view StoryGraph::GetOption(int index, int option) const {
+    return GetString(options[nodes[index].firstOption + option]);
+}
+
+uint32_t StoryGraph::GetEncounterWeight(int index) const {
+    return nodes[index].encounterWeight;
+}
+
+StoryOptionScript StoryGraph::GetOptionScript(int index, int option) const {
+    return optionScripts[nodes[index].firstOption + option];
+}
+
+const StoryInstruction* StoryGraph::GetCode() const {
+    return code;
+}
+
+int StoryGraph::GetChoiceCount(int index) const {
+    return static_cast<int>(nodes[index].transitionCount);
+}
+
+int StoryGraph::GetNextNode(int index, int choice) const {
+    return static_cast<int>(transitions[nodes[index].firstTransition + choice]);
+}
+
+StoryString StoryGraph::AddString(std::string_view text) {
+    StoryString result = { static_cast<uint32_t>(ownedStrings.size()), static_cast<uint32_t>(text.size()) };
+    ownedStrings.insert(ownedStrings.end(), text.begin(), text.end());
+    return result;
+}
+
+std::string_view StoryGraph::GetString(StoryString text) const {
+    return std::string_view(strings + text.offset, text.length);
+}
+
+// Check that every offset, count and index in the tables stays in range
+bool StoryGraph::ValidateTables() const {
+    for (uint32_t index = 0; index < nodeCount; ++index) {
+        const StoryNodeRecord& node = nodes[index];
+        bool stringsValid = IsValidString(node.name) && IsValidString(node.text) && IsValidString(node.asciiArt)
+            && IsValidString(node.audioFile) && IsValidString(node.musicFile) && IsValidString(node.imageFile);
+        if (!stringsValid
+            || static_cast<uint64_t>(node.firstOption) + node.optionCount > optionCount
+            || static_cast<uint64_t>(node.firstTransition) + node.transitionCount > transitionCount) {
+            return false;
+        }
+    }
+    for (uint32_t option = 0; option < optionCount; ++option) {
+        const StoryOptionScript& script = optionScripts[option];
+        if (!IsValidString(options[option])
+            || (script.condition != NoScript && script.condition >= instructionCount)
+            || (script.effect != NoScript && script.effect >= instructionCount)) {
+            return false;
+        }
+    }
+    for (uint32_t transition = 0; transition < transitionCount; ++transition) {
+        if (transitions[transition] >= nodeCount) {
+            return false;
+        }
+    }
+
+    // Lookups probe until an empty slot, so there must be one
+    bool hasEmptySlot = nameTableSize == 0;
+    for (uint32_t slot = 0; slot < nameTableSize; ++slot) {
+        if (nameTable[slot] > nodeCount) {
+            return false;
+        }
+        hasEmptySlot = hasEmptySlot || nameTable[slot] == 0;
+    }
+    if (!hasEmptySlot) {
+        return false;
+    }
+
+    for (uint32_t variable = 0; variable < variableCount; ++variable) {
+        if (!IsValidString(variables[variable].name)) {
+            return false;
+        }
+    }
+    return ValidateScriptCode(code, instructionCount, variableCount);
+}
+
+bool StoryGraph::IsValidString(StoryString text) const {
+    return static_cast<uint64_t>(text.offset) + text.length <= stringPoolSize;
+}
+
+// Double the name table and reinsert every node
+void StoryGraph::GrowNameTable() {
+    size_t newSize = ownedNameTable.empty() ? InitialNameTableSize : ownedNameTable.size() * 2;
+    ownedNameTable.assign(newSize, 0);
+
+    uint32_t mask = static_cast<uint32_t>(newSize) - 1;
+    for (size_t i = 0; i < ownedNodes.size(); ++i) {
+        const StoryString& name = ownedNodes[i].name;
+        uint32_t slot = HashName(std::string_view(ownedStrings.data() + name.offset, name.length)) & mask;
+        while (ownedNameTable[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        ownedNameTable[slot] = static_cast<uint32_t>(i) + 1;
+    }
+}
+
+// Point the accessor tables at the owned vectors
+void StoryGraph::BindOwnedTables() {
+    nodes = ownedNodes.data();
+    options = ownedOptions.data();
+    optionScripts = ownedOptionScripts.data();
+    code = ownedCode.data();
+    transitions = ownedTransitions.data();
+    nameTable = ownedNameTable.data();
+    variables = ownedVariables.data();
+    strings = ownedStrings.data();
+    nodeCount = static_cast<uint32_t>(ownedNodes.size());
+    optionCount = static_cast<uint32_t>(ownedOptions.size());
+    transitionCount = static_cast<uint32_t>(ownedTransitions.size());
+    nameTableSize = static_cast<uint32_t>(ownedNameTable.size());
+    variableCount = static_cast<uint32_t>(ownedVariables.size());
+    instructionCount = static_cast<uint32_t>(ownedCode.size());
+    stringPoolSize = static_cast<uint32_t>(ownedStrings.size());
+}
@@ -0,0 +1,202 @@
+#ifndef STORY_GRAPH_H
+#define STORY_GRAPH_H
+
+#include "mapped_file.h"
+#include "story_script.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Authoring form of a node, filled in by the story loader before it is packed into a StoryGraph
+class StoryNode {
+public:
+    std::string text;
+    std::vector<std::string> options;
+    std::vector<std::pair<int, std::string>> nextNodes;
+    std::string asciiArt;
+    std::string audioFile;
+    std::string musicFile; // Soundtrack from this node on
+    std::string imageFile; // New member for image file
+    uint32_t encounterWeight = 0; // Relative chance of being picked as a random encounter (0 = never)
+    std::vector<StoryOptionScript> optionScripts; // Condition/effect of each option, as offsets into scriptCode
+    std::vector<StoryInstruction> scriptCode;     // Compiled scripts of this node's options
+
+    // Default constructor
+    StoryNode() = default;
+
+    // Custom constructor
+    StoryNode(const std::string& text, const std::vector<std::string>& options, const std::vector<std::pair<int, std::string>>& nextNodes, const std::string& imageFile = "")
+        : text(text), options(options), nextNodes(nextNodes), imageFile(imageFile) {}
+
+    // Empty every field but keep the allocated capacity for reuse
+    void Clear();
+};
+
+// String stored in a story's string pool
+struct StoryString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Fixed-size node entry of a compiled story
+struct StoryNodeRecord {
+    StoryString name;
+    StoryString text;
+    StoryString asciiArt;
+    StoryString audioFile;
+    StoryString musicFile;
+    StoryString imageFile;
+    uint32_t firstOption;     // Index into the option table
+    uint32_t optionCount;
+    uint32_t firstTransition; // Index into the transition table
+    uint32_t transitionCount;
+    uint32_t flags;           // StoryNodeFlags
+    uint32_t encounterWeight; // Random encounter weight (0 if the node is not an encounter)
+};
+
+// Story variable and the value it has when a game starts
+struct StoryVariable {
+    StoryString name;
+    int32_t initialValue;
+};
+
+enum StoryNodeFlags : uint32_t {
+    StoryNodeDefined = 1 // The node was defined, not only referenced by a transition
+};
+
+// Header of a compiled story file. The tables follow it in this order:
+// node records, option strings, option scripts, script code, transition
+// targets, name hash table, variables, string pool.
+struct StoryFileHeader {
+    char magic[4];            // "PDST"
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t optionCount;
+    uint32_t transitionCount;
+    uint32_t nameTableSize;   // Power of two; entries are node index + 1, 0 is empty
+    uint32_t stringPoolSize;
+    uint32_t variableCount;
+    uint32_t instructionCount;
+    uint32_t reserved;
+};
+
+// Story nodes addressed by dense integer indices. Node names are interned as
+// nodes are added, and all strings live in one pool that the accessors return
+// as std::string_view. A graph either owns its tables (built by the loader) or
+// reads them straight out of a memory-mapped compiled story file.
+class StoryGraph {
+public:
+    static const int InvalidNode = -1;
+    static const uint32_t FileVersion = 4;
+
+    StoryGraph();
+
+    StoryGraph(const StoryGraph&) = delete;
+    StoryGraph& operator=(const StoryGraph&) = delete;
+
+    // Return the index for a node name, assigning a new one if it has not been seen
+    int InternNode(std::string_view name);
+
+    // Look up a node index by name (InvalidNode if the name is unknown)
+    int FindNode(std::string_view name) const;
+
+    // Define a node by packing an authored node into the graph's tables
+    int AddNode(std::string_view name, const StoryNode& node);
+
+    // Declare a story variable; returns its index, or -1 if the name is taken
+    int AddVariable(std::string_view name, int32_t initialValue);
+
+    // Look up a variable index by name (-1 if there is no such variable)
+    int FindVariable(std::string_view name) const;
+
+    int GetVariableCount() const;
+    std::string_view GetVariableName(int variable) const;
+    int32_t GetVariableInitialValue(int variable) const;
+
+    // Remove all nodes and release any mapped file
+    void Clear();
+
+    // Write the graph as a compiled story file
+    bool SaveCompiled(const std::string& filename) const;
+
+    // Map a compiled story file and use its tables in place
+    bool OpenCompiled(const std::string& filename);
+
+    int GetNodeCount() const;
+
+    // Hash of the node and variable names in index order; changes whenever their
+    // indices would (used to reject save files made with a different story)
+    uint64_t GetFingerprint() const;
+
+    // True if the index refers to a node that was defined (not just referenced)
+    bool IsDefined(int index) const;
+
+    std::string_view GetNodeName(int index) const;
+    std::string_view GetText(int index) const;
+    std::string_view GetAsciiArt(int index) const;
+    std::string_view GetAudioFile(int index) const;
+    std::string_view GetMusicFile(int index) const;
+    std::string_view GetImageFile(int index) const;
+
+    // Options shown to the player (option is zero based)
+    int GetOptionCount(int index) const;
+    std::string_view GetOption(int index, int option) const;
+
+    // Condition and effect scripts of an option (offsets into GetCode(), NoScript if absent)
+    StoryOptionScript GetOptionScript(int index, int option) const;
+
+    // Compiled scripts of every option, for RunScript
+    const StoryInstruction* GetCode() const;
+
+    // Relative chance of the node being picked as a random encounter (0 = never)
+    uint32_t GetEncounterWeight(int index) const;
+
+    // Number of transitions leaving a node
+    int GetChoiceCount(int index) const;
+
+    // Target index of a node's transition (choice is zero based)
+    int GetNextNode(int index, int choice) const;
+
+private:
+    StoryString AddString(std::string_view text);
+    std::string_view GetString(StoryString text) const;
+
+    // Check that every offset, count and index in the tables stays in range
+    // (run on compiled stories, which may be stale or damaged)
+    bool ValidateTables() const;
+    bool IsValidString(StoryString text) const;
+    void GrowNameTable();
+    void BindOwnedTables();
+
+    // Tables read by the accessors; point either at the vectors below or into the mapping
+    const StoryNodeRecord* nodes;
+    const StoryString* options;
+    const StoryOptionScript* optionScripts;
+    const StoryInstruction* code;
+    const uint32_t* transitions;
+    const uint32_t* nameTable;
+    const StoryVariable* variables;
+    const char* strings;
+    uint32_t nodeCount;
+    uint32_t optionCount;
+    uint32_t transitionCount;
+    uint32_t nameTableSize;
+    uint32_t variableCount;
+    uint32_t instructionCount;
+    uint32_t stringPoolSize;
+
+    // Storage for graphs built at runtime
+    std::vector<StoryNodeRecord> ownedNodes;
+    std::vector<StoryString> ownedOptions;
+    std::vector<StoryOptionScript> ownedOptionScripts;
+    std::vector<StoryInstruction> ownedCode;
+    std::vector<uint32_t> ownedTransitions;
+    std::vector<uint32_t> ownedNameTable;
+    std::vector<StoryVariable> ownedVariables;
+    std::vector<char> ownedStrings;
+
+    MappedFile mappedFile; // Backing file of a compiled story
+};
+
+#endif // STORY_GRAPH_H
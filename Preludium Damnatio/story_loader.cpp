@@ -0,0 +1,248 @@
+#include "story_loader.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+    const size_t ReadBufferSize = 64 * 1024; // Stream buffer used while reading story files
+
+    bool IsSpace(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    size_t SkipSpaces(const std::string& line, size_t pos) {
+        while (pos < line.size() && IsSpace(line[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    size_t SkipWord(const std::string& line, size_t pos) {
+        while (pos < line.size() && !IsSpace(line[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // Variable names follow the script syntax: a letter or '_', then letters, digits or '_'
+    bool IsVariableName(std::string_view name) {
+        if (name.empty() || name == "true" || name == "false" || (name[0] >= '0' && name[0] <= '9')) {
+            return false;
+        }
+        for (char c : name) {
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Compare the keyword at line[begin, end) against a literal
+    bool IsKeyword(const std::string& line, size_t begin, size_t end, const char* keyword) {
+        return line.compare(begin, end - begin, keyword) == 0;
+    }
+}
+
+// Load a story file into the graph
+bool StoryLoader::LoadFile(const std::string& filename, StoryGraph& graph) {
+    std::vector<char> buffer(ReadBufferSize);
+    std::ifstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.open(filename, std::ios::in | std::ios::binary);
+    if (!file) {
+        error = "Could not open story file: " + filename;
+        std::cerr << error << std::endl;
+        return false;
+    }
+    return Load(file, filename, graph);
+}
+
+// Parse a .story file or map a compiled .storyc file
+bool StoryLoader::Open(const std::string& filename, StoryGraph& graph) {
+    const std::string compiledExtension = ".storyc";
+    bool compiled = filename.size() >= compiledExtension.size()
+        && filename.compare(filename.size() - compiledExtension.size(), compiledExtension.size(), compiledExtension) == 0;
+
+    if (!compiled) {
+        return LoadFile(filename, graph);
+    }
+
+    error.clear();
+    if (!graph.OpenCompiled(filename)) {
+        error = "Could not open compiled story: " + filename;
+        return false;
+    }
+    return true;
+}
+
+// Load a story from a stream, one line at a time
+bool StoryLoader::Load(std::istream& input, const std::string& name, StoryGraph& graph) {
+    graph.Clear();
+    error.clear();
+
+    std::string line;     // Reused for every line so the loader never reallocates per line
+    std::string nodeName; // Name of the node being read (empty before the first node line)
+    StoryNode node;       // Scratch node, packed into the graph when the next node starts
+    size_t nodeLine = 0;  // Line the node being read starts on
+    size_t lineNumber = 0;
+
+    while (std::getline(input, line)) {
+        ++lineNumber;
+
+        // Tolerate files saved with Windows line endings
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        size_t keywordBegin = SkipSpaces(line, 0);
+        if (keywordBegin == line.size() || line[keywordBegin] == '#') {
+            continue; // Blank line or comment
+        }
+
+        size_t keywordEnd = SkipWord(line, keywordBegin);
+        size_t valueBegin = SkipSpaces(line, keywordEnd);
+        size_t valueEnd = line.size();
+        while (valueEnd > valueBegin && IsSpace(line[valueEnd - 1])) {
+            --valueEnd;
+        }
+        size_t valueLength = valueEnd - valueBegin;
+
+        if (IsKeyword(line, keywordBegin, keywordEnd, "node")) {
+            if (valueLength == 0) {
+                return Fail(name, lineNumber, "node needs a name");
+            }
+            if (!nodeName.empty() && !AddNode(name, nodeLine, nodeName, node, graph)) {
+                return false;
+            }
+            nodeName.assign(line, valueBegin, valueLength);
+            nodeLine = lineNumber;
+            node.Clear();
+            if (graph.IsDefined(graph.FindNode(nodeName))) {
+                return Fail(name, lineNumber, "node '" + nodeName + "' is defined twice");
+            }
+            continue;
+        }
+
+        // Variables are global and may be declared anywhere before they are used
+        if (IsKeyword(line, keywordBegin, keywordEnd, "var")) {
+            size_t nameEnd = SkipWord(line, valueBegin);
+            size_t initialBegin = SkipSpaces(line, nameEnd);
+            char* initialEnd = nullptr;
+            errno = 0;
+            long long initialValue = initialBegin < valueEnd ? std::strtoll(line.c_str() + initialBegin, &initialEnd, 10) : 0;
+            std::string_view variableName = std::string_view(line).substr(valueBegin, nameEnd - valueBegin);
+            if (!IsVariableName(variableName) || (initialBegin < valueEnd && initialEnd != line.c_str() + valueEnd)) {
+                return Fail(name, lineNumber, "expected 'var <name> [initial value]'");
+            }
+            if (errno == ERANGE || initialValue < INT32_MIN || initialValue > INT32_MAX) {
+                return Fail(name, lineNumber, "initial value of '" + std::string(variableName) + "' is out of range");
+            }
+            if (graph.AddVariable(variableName, static_cast<int32_t>(initialValue)) < 0) {
+                return Fail(name, lineNumber, "variable '" + std::string(variableName) + "' is declared twice");
+            }
+            continue;
+        }
+
+        if (nodeName.empty()) {
+            return Fail(name, lineNumber, "expected a node line before node properties");
+        }
+
+        if (IsKeyword(line, keywordBegin, keywordEnd, "text")) {
+            if (!node.text.empty()) {
+                node.text += ' ';
+            }
+            node.text.append(line, valueBegin, valueLength);
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "option")) {
+            node.options.emplace_back(line, valueBegin, valueLength);
+            node.optionScripts.push_back({ NoScript, NoScript });
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "when") || IsKeyword(line, keywordBegin, keywordEnd, "do")) {
+            bool condition = IsKeyword(line, keywordBegin, keywordEnd, "when");
+            if (node.optionScripts.empty()) {
+                return Fail(name, lineNumber, std::string(condition ? "'when'" : "'do'") + " must follow an option");
+            }
+            uint32_t& script = condition ? node.optionScripts.back().condition : node.optionScripts.back().effect;
+            if (script != NoScript) {
+                return Fail(name, lineNumber, std::string("option already has a ") + (condition ? "condition" : "effect"));
+            }
+
+            uint32_t offset = static_cast<uint32_t>(node.scriptCode.size());
+            std::string_view source = std::string_view(line).substr(valueBegin, valueLength);
+            bool compiled = condition
+                ? scriptCompiler.CompileCondition(source, graph, node.scriptCode)
+                : scriptCompiler.CompileEffect(source, graph, node.scriptCode);
+            if (!compiled) {
+                return Fail(name, lineNumber, scriptCompiler.GetError());
+            }
+            script = offset;
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "next")) {
+            char* choiceEnd = nullptr;
+            long choice = std::strtol(line.c_str() + valueBegin, &choiceEnd, 10);
+            size_t targetBegin = SkipSpaces(line, static_cast<size_t>(choiceEnd - line.c_str()));
+            if (choiceEnd == line.c_str() + valueBegin || targetBegin >= valueEnd) {
+                return Fail(name, lineNumber, "expected 'next <choice> <node>'");
+            }
+            // Transitions are stored by position, so the choices must be listed in order
+            if (choice != static_cast<long>(node.nextNodes.size())) {
+                return Fail(name, lineNumber, "expected 'next " + std::to_string(node.nextNodes.size())
+                    + " <node>'; choices must be listed in order from 0");
+            }
+            node.nextNodes.emplace_back(static_cast<int>(choice), std::string(line, targetBegin, valueEnd - targetBegin));
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "image")) {
+            node.imageFile.assign(line, valueBegin, valueLength);
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "audio")) {
+            node.audioFile.assign(line, valueBegin, valueLength);
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "music")) {
+            node.musicFile.assign(line, valueBegin, valueLength);
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "encounter")) {
+            char* weightEnd = nullptr;
+            errno = 0;
+            long long weight = std::strtoll(line.c_str() + valueBegin, &weightEnd, 10);
+            if (weightEnd != line.c_str() + valueEnd || errno == ERANGE || weight <= 0 || weight > UINT32_MAX) {
+                return Fail(name, lineNumber, "expected 'encounter <weight>' with a positive weight");
+            }
+            node.encounterWeight = static_cast<uint32_t>(weight);
+        }
+        else if (IsKeyword(line, keywordBegin, keywordEnd, "ascii")) {
+            node.asciiArt.assign(line, valueBegin, valueLength);
+        }
+        else {
+            return Fail(name, lineNumber, "unknown keyword '" + line.substr(keywordBegin, keywordEnd - keywordBegin) + "'");
+        }
+    }
+
+    if (input.bad()) {
+        return Fail(name, lineNumber, "read error");
+    }
+
+    return nodeName.empty() || AddNode(name, nodeLine, nodeName, node, graph);
+}
+
+// Description of the last parse error
+const std::string& StoryLoader::GetError() const {
+    return error;
+}
+
+bool StoryLoader::AddNode(const std::string& name, size_t nodeLine, const std::string& nodeName, const StoryNode& node, StoryGraph& graph) {
+    if (node.options.size() > node.nextNodes.size()) {
+        return Fail(name, nodeLine, "node '" + nodeName + "' has " + std::to_string(node.options.size())
+            + " options but " + std::to_string(node.nextNodes.size()) + " next nodes");
+    }
+    graph.AddNode(nodeName, node);
+    return true;
+}
+
+bool StoryLoader::Fail(const std::string& name, size_t lineNumber, const std::string& message) {
+    error = name + ":" + std::to_string(lineNumber) + ": " + message;
+    std::cerr << error << std::endl;
+    return false;
+}
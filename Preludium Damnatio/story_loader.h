@@ -0,0 +1,35 @@
+#ifndef STORY_LOADER_H
+#define STORY_LOADER_H
+
+#include "story_graph.h"
+#include <istream>
+#include <string>
+
+// Reads the line-based story format (see assets/stories/*.story) in a single
+// pass. Only one line and one node are held at a time; each node is packed
+// into the graph's string pool as soon as the next one starts, so memory use
+// of the loader itself does not grow with the size of the file.
+class StoryLoader {
+public:
+    // Load a story file into the graph, replacing its contents
+    bool LoadFile(const std::string& filename, StoryGraph& graph);
+
+    // Parse a .story file or map a compiled .storyc file, depending on the extension
+    bool Open(const std::string& filename, StoryGraph& graph);
+
+    // Load a story from any stream (name is only used in error messages)
+    bool Load(std::istream& input, const std::string& name, StoryGraph& graph);
+
+    // Description of the last parse error
+    const std::string& GetError() const;
+
+private:
+    // Pack a finished node into the graph, rejecting options that lead nowhere
+    bool AddNode(const std::string& name, size_t nodeLine, const std::string& nodeName, const StoryNode& node, StoryGraph& graph);
+    bool Fail(const std::string& name, size_t lineNumber, const std::string& message);
+
+    std::string error; // Last parse error
+    ScriptCompiler scriptCompiler;
+};
+
+#endif // STORY_LOADER_H
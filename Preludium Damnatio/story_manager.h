@@ -4,52 +4,92 @@
 // Include necessary headers
 #include "render_manager.h"
 #include "input_manager.h"
+#include "story_definition.h"
+#include "story_session.h"
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <algorithm>
+#include <cstdint>
 
-class StoryNode {
-public:
-    std::string text;
-    std::vector<std::string> options;
-    std::vector<std::pair<int, std::string>> nextNodes;
-    std::string asciiArt;
-    std::string audioFile;
-    std::string imageFile; // New member for image file
-
-    // Default constructor
-    StoryNode() = default;
-
-    // Custom constructor
-    StoryNode(const std::string& text, const std::vector<std::string>& options, const std::vector<std::pair<int, std::string>>& nextNodes, const std::string& imageFile = "")
-        : text(text), options(options), nextNodes(nextNodes), imageFile(imageFile) {}
-};
-
+// Plays a story for the local player: one StoryDefinition and one
+// StorySession, drawn with the RenderManager
 class StoryManager {
 public:
     // Updated constructor to accept RenderManager reference
     StoryManager(InputManager& inputManager, RenderManager& renderManager);
-    void LoadStory();
+    // Load the story graph from a story file (.story text or .storyc compiled)
+    bool LoadStory(const std::string& storyFile);
     void DisplayCurrentNode();
+
+    // Take a choice (1 based); the caller draws the new node
     void HandleChoice(int choice);
 
-    // Public methods for accessing story details
-    const std::vector<std::string>& GetCurrentOptions() const;
-    const std::string& GetCurrentAsciiArt() const;
-    const std::string& GetCurrentAudio() const;
+    // Where DisplayCurrentNode drew each shown option, in order (for mouse picks)
+    const std::vector<SDL_Rect>& GetOptionBoxes() const;
+
+    // Go back to the "start" node of the loaded story
+    void Restart();
+
+    // Seed the session's random generator (random encounters), for repeatable runs
+    void SetRandomSeed(uint64_t seed);
+
+    // Encode the player's progress into snapshot, reusing its capacity
+    void SaveSnapshot(std::vector<uint8_t>& snapshot) const;
+
+    // Resume from a snapshot made with the same story; leaves the state untouched on failure
+    bool LoadSnapshot(const uint8_t* data, size_t size);
+
+    // Write a snapshot to disk (atomically replacing any older save) or resume from one
+    bool SaveGame(const std::string& filename) const;
+    bool LoadGame(const std::string& filename);
+
+    // The last nodes visited before the current one (up to StorySession::MaxHistory), oldest first
+    int GetHistoryCount() const;
+    int GetHistoryNode(int index) const;
+
+    // Current value of a story variable
+    int32_t GetVariable(int variable) const;
+
+    // Public methods for accessing story details (only the options whose conditions hold are counted)
+    int GetCurrentOptionCount() const;
+    std::string_view GetCurrentOption(int option) const;
+    std::string_view GetCurrentAsciiArt() const;
+    std::string_view GetCurrentAudio() const;
+    std::string_view GetCurrentMusic() const; // Empty if the node keeps the music playing
+
+    // Soundtrack in effect at the current node: its own, or that of the last
+    // node visited that set one (empty if none has)
+    std::string_view GetPlayingMusic() const;
+    std::string_view GetCurrentNodeName() const;
     bool NeedsAsciiArt() const;
     bool NeedsAudio() const;
 
+    // Every audio file the story's nodes play, each listed once (for preloading)
+    std::vector<std::string> GetAudioFiles() const;
+
     // New method to check if the game is over
     bool IsGameOver() const;
 
 private:
-    std::map<std::string, StoryNode> storyNodes;
-    std::vector<std::string> randomNodes;
-    std::string currentNode;
+    // Throws std::out_of_range if the current node is not a defined node
+    void CheckCurrentNode() const;
+
+    // Have the images of the nodes the shown options lead to decoded in the
+    // background, and tell the texture cache how far every image is from
+    // the current node; once per node
+    void PrefetchNextImages();
+
+    StoryDefinition story; // The loaded story
+    StorySession session;  // The player's progress through it
     InputManager& inputManager;
     RenderManager& renderManager; // Changed to reference
+    std::vector<SDL_Rect> optionBoxes; // Options drawn by DisplayCurrentNode
+    int prefetchedNode; // Node whose next images were prefetched last
+    std::vector<std::string_view> nextImages; // Reused by PrefetchNextImages
+    std::vector<int> nodeDistances;           // Likewise
+    std::vector<int> searchQueue;             // Likewise
+    std::vector<ImageDistance> imageDistances; // Likewise
 };
 
 #endif // STORY_MANAGER_H
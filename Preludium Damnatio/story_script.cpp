@@ -0,0 +1,440 @@
+#include "story_script.h"
+#include "story_graph.h"
+#include <cstdint>
+#include <limits>
+
+namespace {
+    const std::string_view TwoCharOperators[] = { "&&", "||", "==", "!=", "<=", ">=", "+=", "-=" };
+
+    bool IsNameStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    bool IsDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // Arithmetic wraps around instead of overflowing
+    int32_t Wrap(uint32_t value) {
+        return static_cast<int32_t>(value);
+    }
+
+    int32_t Divide(int32_t a, int32_t b) {
+        if (b == 0) {
+            return 0;
+        }
+        if (b == -1) {
+            return Wrap(0u - static_cast<uint32_t>(a));
+        }
+        return a / b;
+    }
+
+    int32_t Remainder(int32_t a, int32_t b) {
+        if (b == 0 || b == -1) {
+            return 0;
+        }
+        return a % b;
+    }
+}
+
+// Compile an expression whose value the script returns
+bool ScriptCompiler::CompileCondition(std::string_view source, const StoryGraph& graph, std::vector<StoryInstruction>& code) {
+    size_t start = code.size();
+    Begin(source, graph, code);
+    if (token == Token::End) {
+        return Fail("empty condition");
+    }
+
+    bool compiled = ParseOr(0) && (token == Token::End || Fail("unexpected '" + std::string(tokenText) + "'"));
+    if (!compiled) {
+        code.resize(start);
+        return false;
+    }
+    Emit(OpReturn, 0, 0, 0, 0);
+    return true;
+}
+
+// Compile assignments separated by ';'
+bool ScriptCompiler::CompileEffect(std::string_view source, const StoryGraph& graph, std::vector<StoryInstruction>& code) {
+    size_t start = code.size();
+    Begin(source, graph, code);
+    if (token == Token::End) {
+        return Fail("empty effect");
+    }
+
+    bool compiled = true;
+    while (compiled && token != Token::End) {
+        int variable = 0;
+        if (!ParseVariable(variable)) {
+            compiled = false;
+        }
+        else if (Accept("=")) {
+            compiled = ParseOr(0);
+        }
+        else if (token == Token::Operator && (tokenText == "+=" || tokenText == "-=")) {
+            StoryOpcode opcode = tokenText == "+=" ? OpAdd : OpSubtract;
+            Advance();
+            Emit(OpLoadVariable, 0, 0, 0, variable);
+            compiled = ParseOr(1);
+            if (compiled) {
+                Emit(opcode, 0, 0, 1, 0);
+            }
+        }
+        else {
+            compiled = Fail("expected '=', '+=' or '-=' after a variable name");
+        }
+
+        if (compiled) {
+            Emit(OpStoreVariable, 0, 0, 0, variable);
+            if (!Accept(";") && token != Token::End) {
+                compiled = Fail("expected ';' between effects");
+            }
+        }
+    }
+
+    if (!compiled) {
+        code.resize(start);
+        return false;
+    }
+    Emit(OpLoadConst, 0, 0, 0, 0);
+    Emit(OpReturn, 0, 0, 0, 0);
+    return true;
+}
+
+// Description of the last compile error
+const std::string& ScriptCompiler::GetError() const {
+    return error;
+}
+
+void ScriptCompiler::Begin(std::string_view source, const StoryGraph& graph, std::vector<StoryInstruction>& code) {
+    this->source = source;
+    this->graph = &graph;
+    this->code = &code;
+    position = 0;
+    error.clear();
+    Advance();
+}
+
+// Read the next token
+void ScriptCompiler::Advance() {
+    while (position < source.size() && (source[position] == ' ' || source[position] == '\t')) {
+        ++position;
+    }
+    size_t begin = position;
+    if (position == source.size()) {
+        token = Token::End;
+        tokenText = "end of line";
+        return;
+    }
+
+    char c = source[position];
+    if (IsDigit(c)) {
+        int64_t value = 0;
+        bool tooLarge = false;
+        while (position < source.size() && IsDigit(source[position])) {
+            if (!tooLarge) {
+                value = value * 10 + (source[position] - '0');
+                tooLarge = value > std::numeric_limits<int32_t>::max();
+            }
+            ++position;
+        }
+        token = Token::Number;
+        tokenValue = tooLarge ? -1 : static_cast<int32_t>(value); // -1 is reported as too large
+    }
+    else if (IsNameStart(c)) {
+        while (position < source.size() && (IsNameStart(source[position]) || IsDigit(source[position]))) {
+            ++position;
+        }
+        token = Token::Name;
+    }
+    else {
+        token = Token::Operator;
+        position += 1;
+        for (std::string_view op : TwoCharOperators) {
+            if (source.substr(begin, 2) == op) {
+                position = begin + 2;
+                break;
+            }
+        }
+    }
+    tokenText = source.substr(begin, position - begin);
+}
+
+// Consume the current token if it is the given operator
+bool ScriptCompiler::Accept(std::string_view op) {
+    if (token != Token::Operator || tokenText != op) {
+        return false;
+    }
+    Advance();
+    return true;
+}
+
+bool ScriptCompiler::ParseVariable(int& variable) {
+    if (token != Token::Name) {
+        return Fail("expected a variable name instead of '" + std::string(tokenText) + "'");
+    }
+    variable = graph->FindVariable(tokenText);
+    if (variable < 0) {
+        return Fail("unknown variable '" + std::string(tokenText) + "'");
+    }
+    Advance();
+    return true;
+}
+
+// a || b: the result is 1 as soon as one side is non-zero
+bool ScriptCompiler::ParseOr(int reg) {
+    if (!ParseAnd(reg)) {
+        return false;
+    }
+    while (Accept("||")) {
+        Emit(OpToBool, reg, reg, 0, 0);
+        size_t jump = Emit(OpJumpIfNotZero, 0, reg, 0, 0);
+        if (!ParseAnd(reg)) {
+            return false;
+        }
+        Emit(OpToBool, reg, reg, 0, 0);
+        PatchJump(jump);
+    }
+    return true;
+}
+
+// a && b: the right side is skipped when the left one is zero
+bool ScriptCompiler::ParseAnd(int reg) {
+    if (!ParseComparison(reg)) {
+        return false;
+    }
+    while (Accept("&&")) {
+        size_t jump = Emit(OpJumpIfZero, 0, reg, 0, 0);
+        if (!ParseComparison(reg)) {
+            return false;
+        }
+        Emit(OpToBool, reg, reg, 0, 0);
+        PatchJump(jump);
+    }
+    return true;
+}
+
+bool ScriptCompiler::ParseComparison(int reg) {
+    if (!ParseSum(reg)) {
+        return false;
+    }
+
+    StoryOpcode opcode;
+    if (Accept("<")) {
+        opcode = OpLess;
+    }
+    else if (Accept("<=")) {
+        opcode = OpLessEqual;
+    }
+    else if (Accept(">")) {
+        opcode = OpGreater;
+    }
+    else if (Accept(">=")) {
+        opcode = OpGreaterEqual;
+    }
+    else if (Accept("==")) {
+        opcode = OpEqual;
+    }
+    else if (Accept("!=")) {
+        opcode = OpNotEqual;
+    }
+    else {
+        return true;
+    }
+
+    if (!CheckRegister(reg + 1) || !ParseSum(reg + 1)) {
+        return false;
+    }
+    Emit(opcode, reg, reg, reg + 1, 0);
+    return true;
+}
+
+bool ScriptCompiler::ParseSum(int reg) {
+    if (!ParseProduct(reg)) {
+        return false;
+    }
+    while (true) {
+        StoryOpcode opcode;
+        if (Accept("+")) {
+            opcode = OpAdd;
+        }
+        else if (Accept("-")) {
+            opcode = OpSubtract;
+        }
+        else {
+            return true;
+        }
+        if (!CheckRegister(reg + 1) || !ParseProduct(reg + 1)) {
+            return false;
+        }
+        Emit(opcode, reg, reg, reg + 1, 0);
+    }
+}
+
+bool ScriptCompiler::ParseProduct(int reg) {
+    if (!ParseUnary(reg)) {
+        return false;
+    }
+    while (true) {
+        StoryOpcode opcode;
+        if (Accept("*")) {
+            opcode = OpMultiply;
+        }
+        else if (Accept("/")) {
+            opcode = OpDivide;
+        }
+        else if (Accept("%")) {
+            opcode = OpRemainder;
+        }
+        else {
+            return true;
+        }
+        if (!CheckRegister(reg + 1) || !ParseUnary(reg + 1)) {
+            return false;
+        }
+        Emit(opcode, reg, reg, reg + 1, 0);
+    }
+}
+
+bool ScriptCompiler::ParseUnary(int reg) {
+    if (Accept("!")) {
+        if (!ParseUnary(reg)) {
+            return false;
+        }
+        Emit(OpNot, reg, reg, 0, 0);
+        return true;
+    }
+    if (Accept("-")) {
+        if (!ParseUnary(reg)) {
+            return false;
+        }
+        Emit(OpNegate, reg, reg, 0, 0);
+        return true;
+    }
+    return ParsePrimary(reg);
+}
+
+// Number, true/false, variable or parenthesised expression
+bool ScriptCompiler::ParsePrimary(int reg) {
+    if (token == Token::Number) {
+        if (tokenValue < 0) {
+            return Fail("number '" + std::string(tokenText) + "' is too large");
+        }
+        Emit(OpLoadConst, reg, 0, 0, tokenValue);
+        Advance();
+        return true;
+    }
+    if (token == Token::Name && (tokenText == "true" || tokenText == "false")) {
+        Emit(OpLoadConst, reg, 0, 0, tokenText == "true" ? 1 : 0);
+        Advance();
+        return true;
+    }
+    if (token == Token::Name) {
+        int variable = 0;
+        if (!ParseVariable(variable)) {
+            return false;
+        }
+        Emit(OpLoadVariable, reg, 0, 0, variable);
+        return true;
+    }
+    if (Accept("(")) {
+        if (!ParseOr(reg)) {
+            return false;
+        }
+        return Accept(")") || Fail("expected ')' instead of '" + std::string(tokenText) + "'");
+    }
+    return Fail("expected a value instead of '" + std::string(tokenText) + "'");
+}
+
+bool ScriptCompiler::CheckRegister(int reg) {
+    return reg < MaxScriptRegisters || Fail("expression is too deeply nested");
+}
+
+size_t ScriptCompiler::Emit(StoryOpcode opcode, int dst, int a, int b, int32_t imm) {
+    code->push_back({ opcode, static_cast<uint8_t>(dst), static_cast<uint8_t>(a), static_cast<uint8_t>(b), imm });
+    return code->size() - 1;
+}
+
+// Point a forward jump at the next instruction to be emitted
+void ScriptCompiler::PatchJump(size_t jump) {
+    (*code)[jump].imm = static_cast<int32_t>(code->size() - jump);
+}
+
+bool ScriptCompiler::Fail(const std::string& message) {
+    if (error.empty()) {
+        error = message;
+    }
+    return false;
+}
+
+// Check code read from a file before it is run. Since the compiler only
+// emits forward jumps and ends every script with OpReturn, code that passes
+// always stops within the table.
+bool ValidateScriptCode(const StoryInstruction* code, uint32_t instructionCount, uint32_t variableCount) {
+    if (instructionCount > 0 && code[instructionCount - 1].opcode != OpReturn) {
+        return false; // The last script would run off the end
+    }
+    for (uint32_t i = 0; i < instructionCount; ++i) {
+        const StoryInstruction& in = code[i];
+        if (in.opcode > OpReturn || in.dst >= MaxScriptRegisters || in.a >= MaxScriptRegisters || in.b >= MaxScriptRegisters) {
+            return false;
+        }
+        bool usesVariable = in.opcode == OpLoadVariable || in.opcode == OpStoreVariable;
+        if (usesVariable && (in.imm < 0 || static_cast<uint32_t>(in.imm) >= variableCount)) {
+            return false;
+        }
+        bool jumps = in.opcode == OpJumpIfZero || in.opcode == OpJumpIfNotZero;
+        if (jumps && (in.imm <= 0 || static_cast<uint64_t>(i) + static_cast<uint32_t>(in.imm) >= instructionCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run the script starting at code[start]. Registers live on the stack, so an
+// evaluation never allocates.
+int32_t RunScript(const StoryInstruction* code, uint32_t start, int32_t* variables) {
+    int32_t registers[MaxScriptRegisters] = {};
+    const StoryInstruction* instruction = code + start;
+    while (true) {
+        const StoryInstruction& in = *instruction;
+        int32_t a = registers[in.a];
+        int32_t b = registers[in.b];
+        switch (in.opcode) {
+        case OpLoadConst:     registers[in.dst] = in.imm; break;
+        case OpLoadVariable:  registers[in.dst] = variables[in.imm]; break;
+        case OpStoreVariable: variables[in.imm] = a; break;
+        case OpAdd:           registers[in.dst] = Wrap(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); break;
+        case OpSubtract:      registers[in.dst] = Wrap(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); break;
+        case OpMultiply:      registers[in.dst] = Wrap(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); break;
+        case OpDivide:        registers[in.dst] = Divide(a, b); break;
+        case OpRemainder:     registers[in.dst] = Remainder(a, b); break;
+        case OpLess:          registers[in.dst] = a < b; break;
+        case OpLessEqual:     registers[in.dst] = a <= b; break;
+        case OpGreater:       registers[in.dst] = a > b; break;
+        case OpGreaterEqual:  registers[in.dst] = a >= b; break;
+        case OpEqual:         registers[in.dst] = a == b; break;
+        case OpNotEqual:      registers[in.dst] = a != b; break;
+        case OpNot:           registers[in.dst] = a == 0; break;
+        case OpNegate:        registers[in.dst] = Wrap(0u - static_cast<uint32_t>(a)); break;
+        case OpToBool:        registers[in.dst] = a != 0; break;
+        case OpJumpIfZero:
+            if (a == 0) {
+                instruction += in.imm;
+                continue;
+            }
+            break;
+        case OpJumpIfNotZero:
+            if (a != 0) {
+                instruction += in.imm;
+                continue;
+            }
+            break;
+        case OpReturn:
+            return a;
+        default:
+            return 0; // Unknown instruction
+        }
+        ++instruction;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef STORY_SCRIPT_H
+#define STORY_SCRIPT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class StoryGraph;
+
+// Instructions of the story script VM. Scripts are conditions that decide
+// whether an option is shown ("when !jewel && defiance > 1") and effects run
+// when an option is chosen ("jewel = 1; defiance += 1"). They are compiled
+// when the story is loaded and run against a session's variables.
+enum StoryOpcode : uint8_t {
+    OpLoadConst,     // r[dst] = imm
+    OpLoadVariable,  // r[dst] = variables[imm]
+    OpStoreVariable, // variables[imm] = r[a]
+    OpAdd,           // r[dst] = r[a] + r[b] (and so on for the binary operators)
+    OpSubtract,
+    OpMultiply,
+    OpDivide,        // Division or remainder by zero gives 0
+    OpRemainder,
+    OpLess,
+    OpLessEqual,
+    OpGreater,
+    OpGreaterEqual,
+    OpEqual,
+    OpNotEqual,
+    OpNot,           // r[dst] = !r[a]
+    OpNegate,        // r[dst] = -r[a]
+    OpToBool,        // r[dst] = r[a] != 0
+    OpJumpIfZero,    // if r[a] == 0, jump imm instructions (relative to this one)
+    OpJumpIfNotZero,
+    OpReturn         // Stop and return r[a]
+};
+
+struct StoryInstruction {
+    uint8_t opcode; // StoryOpcode
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    int32_t imm;
+};
+
+// Scripts attached to an option, as offsets into the graph's code table
+struct StoryOptionScript {
+    uint32_t condition; // NoScript if the option is always shown
+    uint32_t effect;    // NoScript if choosing the option changes no variables
+};
+
+const uint32_t NoScript = 0xFFFFFFFFu;
+
+// Registers available to one script; expressions nested deeper than this do not compile
+const int MaxScriptRegisters = 16;
+
+// Compiles condition and effect source into register VM instructions.
+// Variables are resolved against the graph, so they must be declared first.
+class ScriptCompiler {
+public:
+    // Compile an expression whose value (non-zero = true) the script returns
+    bool CompileCondition(std::string_view source, const StoryGraph& graph, std::vector<StoryInstruction>& code);
+
+    // Compile assignments separated by ';' ("name = expr", "name += expr", "name -= expr")
+    bool CompileEffect(std::string_view source, const StoryGraph& graph, std::vector<StoryInstruction>& code);
+
+    // Description of the last compile error
+    const std::string& GetError() const;
+
+private:
+    enum class Token {
+        End,
+        Number,
+        Name,
+        Operator
+    };
+
+    void Begin(std::string_view source, const StoryGraph& graph, std::vector<StoryInstruction>& code);
+    void Advance();
+    bool Accept(std::string_view op);
+    bool ParseVariable(int& variable);
+    bool ParseOr(int reg);
+    bool ParseAnd(int reg);
+    bool ParseComparison(int reg);
+    bool ParseSum(int reg);
+    bool ParseProduct(int reg);
+    bool ParseUnary(int reg);
+    bool ParsePrimary(int reg);
+    bool CheckRegister(int reg);
+    size_t Emit(StoryOpcode opcode, int dst, int a, int b, int32_t imm);
+    void PatchJump(size_t jump);
+    bool Fail(const std::string& message);
+
+    std::string_view source;
+    size_t position;
+    Token token;
+    std::string_view tokenText;
+    int32_t tokenValue;
+    const StoryGraph* graph;
+    std::vector<StoryInstruction>* code;
+    std::string error;
+};
+
+// Run the script starting at code[start] and return its result
+int32_t RunScript(const StoryInstruction* code, uint32_t start, int32_t* variables);
+
+// Check code read from a file before it is run: known opcodes, registers
+// and variables in range, and jumps that only go forward and end on a return
+bool ValidateScriptCode(const StoryInstruction* code, uint32_t instructionCount, uint32_t variableCount);
+
+#endif // STORY_SCRIPT_H
@@ -0,0 +1,269 @@
+#include "story_session.h"
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+    const char SnapshotMagic[4] = { 'P', 'D', 'S', 'V' };
+}
+
+StorySession::StorySession(const StoryDefinition& story)
+    : story(&story),
+    currentNode(StoryGraph::InvalidNode),
+    history(),
+    historyStart(0),
+    historyCount(0),
+    musicNode(StoryGraph::InvalidNode)
+{
+}
+
+// Go back to the "start" node with fresh variables and encounters
+void StorySession::Restart() {
+    currentNode = story->GetStartNode();
+    historyStart = 0;
+    historyCount = 0;
+    musicNode = story->GetGraph().GetMusicFile(currentNode).empty() ? StoryGraph::InvalidNode : currentNode;
+    encounterBag.Reset(story->GetEncounters().GetCount());
+    ResetVariables();
+    UpdateVisibleOptions();
+}
+
+// Seed the random generator, for repeatable runs
+void StorySession::SetRandomSeed(uint64_t seed) {
+    random.Seed(seed);
+}
+
+// Set every story variable back to its initial value
+void StorySession::ResetVariables() {
+    const StoryGraph& graph = story->GetGraph();
+    variables.resize(graph.GetVariableCount());
+    for (int variable = 0; variable < graph.GetVariableCount(); ++variable) {
+        variables[variable] = graph.GetVariableInitialValue(variable);
+    }
+}
+
+// Remember a visited node, forgetting the oldest once the ring is full
+void StorySession::AddHistory(int node) {
+    if (historyCount < MaxHistory) {
+        history[(historyStart + historyCount) % MaxHistory] = node;
+        ++historyCount;
+    }
+    else {
+        history[historyStart] = node;
+        historyStart = (historyStart + 1) % MaxHistory;
+    }
+}
+
+// Run the option conditions of the current node to find the options to show
+void StorySession::UpdateVisibleOptions() {
+    const StoryGraph& graph = story->GetGraph();
+    visibleOptions.clear();
+    if (!graph.IsDefined(currentNode)) {
+        return;
+    }
+    for (int option = 0; option < graph.GetOptionCount(currentNode); ++option) {
+        uint32_t condition = graph.GetOptionScript(currentNode, option).condition;
+        if (condition == NoScript || RunScript(graph.GetCode(), condition, variables.data()) != 0) {
+            visibleOptions.push_back(option);
+        }
+    }
+}
+
+// Encode the player's progress into snapshot, reusing its capacity
+void StorySession::SaveSnapshot(std::vector<uint8_t>& snapshot) const {
+    const StoryGraph& graph = story->GetGraph();
+    const EncounterTable& encounters = story->GetEncounters();
+    StorySnapshotHeader header = {};
+    std::memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    header.version = SnapshotVersion;
+    header.storyFingerprint = graph.GetFingerprint();
+    header.randomState = random.GetState();
+    header.currentNode = currentNode;
+    header.historyCount = static_cast<uint32_t>(historyCount);
+    header.encounterCount = static_cast<uint32_t>(encounters.GetCount());
+    header.lastEncounter = encounterBag.lastEncounter;
+    header.variableCount = static_cast<uint32_t>(variables.size());
+    header.musicNode = musicNode;
+
+    size_t variablesSize = sizeof(int32_t) * variables.size();
+    size_t bagSize = sizeof(uint64_t) * encounterBag.drawn.size();
+    snapshot.resize(sizeof(header) + sizeof(uint32_t) * historyCount + variablesSize + bagSize);
+    std::memcpy(snapshot.data(), &header, sizeof(header));
+    uint8_t* entry = snapshot.data() + sizeof(header);
+    for (int i = 0; i < historyCount; ++i) {
+        uint32_t value = static_cast<uint32_t>(GetHistoryNode(i));
+        std::memcpy(entry, &value, sizeof(value));
+        entry += sizeof(value);
+    }
+    if (variablesSize > 0) {
+        std::memcpy(entry, variables.data(), variablesSize);
+        entry += variablesSize;
+    }
+    if (bagSize > 0) {
+        std::memcpy(entry, encounterBag.drawn.data(), bagSize);
+    }
+}
+
+// Resume from a snapshot made with the same story
+bool StorySession::LoadSnapshot(const uint8_t* data, size_t size) {
+    const StoryGraph& graph = story->GetGraph();
+    const EncounterTable& encounters = story->GetEncounters();
+    StorySnapshotHeader header;
+    if (size < sizeof(header)) {
+        std::cerr << "Save snapshot is truncated." << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 || header.version != SnapshotVersion) {
+        std::cerr << "Save snapshot has an unknown format or version." << std::endl;
+        return false;
+    }
+    if (header.storyFingerprint != graph.GetFingerprint()) {
+        std::cerr << "Save snapshot was made with a different story." << std::endl;
+        return false;
+    }
+    size_t bagWords = (static_cast<size_t>(encounters.GetCount()) + 63) / 64;
+    if (header.encounterCount != static_cast<uint32_t>(encounters.GetCount())
+        || header.lastEncounter < -1 || header.lastEncounter >= encounters.GetCount()
+        || header.variableCount != static_cast<uint32_t>(graph.GetVariableCount())) {
+        std::cerr << "Save snapshot was made with a different story." << std::endl;
+        return false;
+    }
+    size_t variablesSize = sizeof(int32_t) * static_cast<size_t>(header.variableCount);
+    if (header.historyCount > static_cast<uint32_t>(MaxHistory)) {
+        std::cerr << "Save snapshot has too long a history." << std::endl;
+        return false;
+    }
+    if (size != sizeof(header) + sizeof(uint32_t) * static_cast<size_t>(header.historyCount) + variablesSize + sizeof(uint64_t) * bagWords) {
+        std::cerr << "Save snapshot is truncated." << std::endl;
+        return false;
+    }
+    bool musicNodeValid = header.musicNode == StoryGraph::InvalidNode
+        || (header.musicNode >= 0 && header.musicNode < graph.GetNodeCount());
+    if ((header.currentNode != story->GetEndNode() && !graph.IsDefined(header.currentNode)) || !musicNodeValid) {
+        std::cerr << "Save snapshot refers to an invalid node." << std::endl;
+        return false;
+    }
+
+    // Check every entry before touching the current state
+    const uint8_t* entry = data + sizeof(header);
+    uint32_t nodeCount = static_cast<uint32_t>(graph.GetNodeCount());
+    for (uint32_t i = 0; i < header.historyCount; ++i) {
+        uint32_t value;
+        std::memcpy(&value, entry + sizeof(value) * i, sizeof(value));
+        if (value >= nodeCount) {
+            std::cerr << "Save snapshot refers to an invalid node." << std::endl;
+            return false;
+        }
+    }
+
+    historyStart = 0;
+    historyCount = static_cast<int>(header.historyCount);
+    for (int i = 0; i < historyCount; ++i) {
+        uint32_t value;
+        std::memcpy(&value, entry + sizeof(value) * i, sizeof(value));
+        history[i] = static_cast<int>(value);
+    }
+    currentNode = header.currentNode;
+    musicNode = header.musicNode;
+    random.SetState(header.randomState);
+    entry += sizeof(uint32_t) * header.historyCount;
+    variables.resize(header.variableCount);
+    if (variablesSize > 0) {
+        std::memcpy(variables.data(), entry, variablesSize);
+        entry += variablesSize;
+    }
+
+    // Restore the encounter bag, counting the encounters it has handed out
+    encounterBag.Reset(encounters.GetCount());
+    if (bagWords > 0) {
+        std::memcpy(encounterBag.drawn.data(), entry, sizeof(uint64_t) * bagWords);
+    }
+    for (int encounter = 0; encounter < encounters.GetCount(); ++encounter) {
+        encounterBag.drawnCount += (encounterBag.drawn[encounter >> 6] >> (encounter & 63)) & 1;
+    }
+    encounterBag.lastEncounter = header.lastEncounter;
+    UpdateVisibleOptions();
+    return true;
+}
+
+// Take a shown option (1 based)
+void StorySession::Choose(int choice) {
+    const StoryGraph& graph = story->GetGraph();
+    if (IsGameOver()) {
+        return;
+    }
+
+    // Choices count only the options that are shown
+    if (choice < 1 || choice > static_cast<int>(visibleOptions.size()) || visibleOptions[choice - 1] >= graph.GetChoiceCount(currentNode)) {
+        throw std::out_of_range("Choice out of range");
+    }
+    int option = visibleOptions[choice - 1];
+
+    // Apply the option's effects, then move to the next node
+    uint32_t effect = graph.GetOptionScript(currentNode, option).effect;
+    if (effect != NoScript) {
+        RunScript(graph.GetCode(), effect, variables.data());
+    }
+    AddHistory(currentNode);
+    currentNode = graph.GetNextNode(currentNode, option);
+
+    // A choice leading to "random_encounter" goes to one of the encounter nodes
+    if (currentNode == story->GetEncounterNode()) {
+        currentNode = story->GetEncounters().Draw(encounterBag, random);
+        if (currentNode == StoryGraph::InvalidNode) {
+            std::cerr << "Story has no random encounters; ending the game." << std::endl;
+            currentNode = story->GetEndNode();
+        }
+    }
+    if (graph.IsDefined(currentNode) && !graph.GetMusicFile(currentNode).empty()) {
+        musicNode = currentNode;
+    }
+    UpdateVisibleOptions();
+}
+
+// The game is over at "end_game", at an undefined node, or at a node with no
+// choices or whose options are all hidden by their conditions
+bool StorySession::IsGameOver() const {
+    if (currentNode == story->GetEndNode() || !story->GetGraph().IsDefined(currentNode)) {
+        return true;
+    }
+    return story->GetGraph().GetChoiceCount(currentNode) == 0 || visibleOptions.empty();
+}
+
+int StorySession::GetCurrentNode() const {
+    return currentNode;
+}
+
+int StorySession::GetOptionCount() const {
+    return static_cast<int>(visibleOptions.size());
+}
+
+int StorySession::GetOption(int option) const {
+    return visibleOptions[option];
+}
+
+int32_t StorySession::GetVariable(int variable) const {
+    return variables[variable];
+}
+
+// The last nodes visited before the current one, oldest first
+int StorySession::GetHistoryCount() const {
+    return historyCount;
+}
+
+int StorySession::GetHistoryNode(int index) const {
+    return history[(historyStart + index) % MaxHistory];
+}
+
+int StorySession::GetMusicNode() const {
+    return musicNode;
+}
+
+// Bytes used by this session, including its arrays
+size_t StorySession::GetMemoryUsage() const {
+    return sizeof(*this)
+        + variables.capacity() * sizeof(int32_t)
+        + visibleOptions.capacity() * sizeof(int)
+        + encounterBag.drawn.capacity() * sizeof(uint64_t);
+}
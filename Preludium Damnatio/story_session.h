@@ -0,0 +1,103 @@
+#ifndef STORY_SESSION_H
+#define STORY_SESSION_H
+
+#include "story_definition.h"
+#include "random_generator.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Header of a saved game snapshot. It is followed by the last visited node
+// indices (historyCount uint32_t values, oldest first), the story variables
+// (variableCount int32_t values) and then the encounter bag (one uint64_t per
+// 64 encounters, a bit set for each one drawn this round).
+struct StorySnapshotHeader {
+    char magic[4];             // "PDSV"
+    uint32_t version;
+    uint64_t storyFingerprint; // StoryGraph::GetFingerprint of the story it was saved from
+    uint64_t randomState;
+    int32_t currentNode;
+    uint32_t historyCount;
+    uint32_t encounterCount;   // Encounters in the story
+    int32_t lastEncounter;     // Encounter drawn most recently (-1 if none)
+    uint32_t variableCount;
+    int32_t musicNode;         // Last node visited that set the music (-1 if none)
+};
+
+// One player's progress through a shared StoryDefinition: the current node,
+// the last few nodes visited, story variables, encounter bag and random
+// generator. Everything about the story itself stays in the definition, so a
+// session is only a few small arrays whatever the length of the game.
+class StorySession {
+public:
+    static const uint32_t SnapshotVersion = 4;
+
+    // Visited nodes kept for going back; older ones are forgotten
+    static const int MaxHistory = 16;
+
+    // The definition must be loaded before Restart is called and outlive the session
+    explicit StorySession(const StoryDefinition& story);
+
+    // Go back to the "start" node with fresh variables and encounters
+    void Restart();
+
+    // Seed the random generator (random encounters), for repeatable runs
+    void SetRandomSeed(uint64_t seed);
+
+    // Take a shown option (1 based). Throws std::out_of_range if there is no such option;
+    // does nothing once the game is over.
+    void Choose(int choice);
+
+    bool IsGameOver() const;
+
+    // Node the player is at (InvalidNode before Restart)
+    int GetCurrentNode() const;
+
+    // Options of the current node whose conditions hold
+    int GetOptionCount() const;
+
+    // Node option index of a shown option (zero based)
+    int GetOption(int option) const;
+
+    int32_t GetVariable(int variable) const;
+
+    // The last nodes visited before the current one (up to MaxHistory), oldest first
+    int GetHistoryCount() const;
+    int GetHistoryNode(int index) const;
+
+    // The current node if it sets the music, otherwise the last node visited
+    // that did (InvalidNode if none has)
+    int GetMusicNode() const;
+
+    // Encode the player's progress into snapshot, reusing its capacity
+    void SaveSnapshot(std::vector<uint8_t>& snapshot) const;
+
+    // Resume from a snapshot made with the same story; leaves the state untouched on failure
+    bool LoadSnapshot(const uint8_t* data, size_t size);
+
+    // Bytes used by this session, including its arrays
+    size_t GetMemoryUsage() const;
+
+private:
+    // Run the option conditions of the current node to find the options to show
+    void UpdateVisibleOptions();
+
+    // Set every story variable back to its initial value
+    void ResetVariables();
+
+    // Remember a visited node, forgetting the oldest once the ring is full
+    void AddHistory(int node);
+
+    const StoryDefinition* story;
+    int currentNode; // Index into the story graph
+    int history[MaxHistory];         // Ring of the nodes visited before currentNode
+    int historyStart;                // Oldest entry of the ring
+    int historyCount;
+    int musicNode;                   // See GetMusicNode
+    std::vector<int32_t> variables;  // Values of the story variables
+    std::vector<int> visibleOptions; // Options of currentNode whose conditions hold, in order
+    EncounterBag encounterBag;       // Encounters already drawn this round
+    RandomGenerator random;          // Saved with the game
+};
+
+#endif // STORY_SESSION_H
@@ -0,0 +1,125 @@
+#include "story_validator.h"
+#include "prepared_image.h"
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+StoryValidator::StoryValidator(const std::string& assetRoot) : assetRoot(assetRoot) {}
+
+// Check the graph and return every issue found
+std::vector<StoryIssue> StoryValidator::Validate(const StoryGraph& graph) const {
+    std::vector<StoryIssue> issues;
+    int startNode = graph.FindNode("start");
+    int endNode = graph.FindNode("end_game");
+    int encounterNode = graph.FindNode("random_encounter");
+
+    std::vector<int> encounters;
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (graph.IsDefined(node) && graph.GetEncounterWeight(node) > 0) {
+            encounters.push_back(node);
+        }
+    }
+
+    if (!graph.IsDefined(startNode)) {
+        issues.push_back({ true, StoryGraph::InvalidNode, "story has no \"start\" node" });
+    }
+
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (!graph.IsDefined(node)) {
+            continue; // Reported at the transitions that reference it
+        }
+
+        std::string name(graph.GetNodeName(node));
+        int optionCount = graph.GetOptionCount(node);
+        int choiceCount = graph.GetChoiceCount(node);
+        if (optionCount != choiceCount) {
+            issues.push_back({ true, node, "node '" + name + "' has " + std::to_string(optionCount)
+                + " options but " + std::to_string(choiceCount) + " next nodes" });
+        }
+
+        for (int choice = 0; choice < choiceCount; ++choice) {
+            int target = graph.GetNextNode(node, choice);
+            if (target == encounterNode && encounters.empty()) {
+                issues.push_back({ true, node, "node '" + name + "' choice " + std::to_string(choice + 1)
+                    + " leads to a random encounter but no node is marked as an encounter" });
+            }
+            else if (target != endNode && target != encounterNode && !graph.IsDefined(target)) {
+                issues.push_back({ true, node, "node '" + name + "' choice " + std::to_string(choice + 1)
+                    + " leads to undefined node '" + std::string(graph.GetNodeName(target)) + "'" });
+            }
+        }
+
+        CheckAsset(graph, node, graph.GetImageFile(node), "image", issues);
+        CheckImageFormat(graph, node, issues);
+        CheckAsset(graph, node, graph.GetAudioFile(node), "audio", issues);
+        CheckAsset(graph, node, graph.GetMusicFile(node), "music", issues);
+    }
+
+    // Walk the transitions from "start" to find nodes the player can never reach
+    // (reaching "random_encounter" reaches every encounter node)
+    if (graph.IsDefined(startNode)) {
+        std::vector<char> reached(graph.GetNodeCount(), 0);
+        std::vector<int> pending = { startNode };
+        reached[startNode] = 1;
+        while (!pending.empty()) {
+            int node = pending.back();
+            pending.pop_back();
+            if (node == encounterNode) {
+                for (int target : encounters) {
+                    if (!reached[target]) {
+                        reached[target] = 1;
+                        pending.push_back(target);
+                    }
+                }
+                continue;
+            }
+            for (int choice = 0; choice < graph.GetChoiceCount(node); ++choice) {
+                int target = graph.GetNextNode(node, choice);
+                if (!reached[target]) {
+                    reached[target] = 1;
+                    pending.push_back(target);
+                }
+            }
+        }
+
+        for (int node = 0; node < graph.GetNodeCount(); ++node) {
+            if (graph.IsDefined(node) && !reached[node]) {
+                issues.push_back({ false, node, "node '" + std::string(graph.GetNodeName(node)) + "' is unreachable from \"start\"" });
+            }
+        }
+    }
+
+    return issues;
+}
+
+void StoryValidator::CheckAsset(const StoryGraph& graph, int node, std::string_view file, const char* kind, std::vector<StoryIssue>& issues) const {
+    if (file.empty()) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::path(assetRoot) / std::filesystem::path(std::string(file));
+    if (!std::filesystem::is_regular_file(path, error)) {
+        issues.push_back({ false, node, "node '" + std::string(graph.GetNodeName(node)) + "' " + kind
+            + " file not found: " + std::string(file) });
+    }
+}
+
+void StoryValidator::CheckImageFormat(const StoryGraph& graph, int node, std::vector<StoryIssue>& issues) const {
+    std::string_view file = graph.GetImageFile(node);
+    if (file.empty()) {
+        return;
+    }
+
+    // Without a current prepared image the game falls back to SDL_LoadBMP
+    std::string path = (std::filesystem::path(assetRoot) / std::filesystem::path(std::string(file))).string();
+    char magic[2] = {};
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.read(magic, sizeof(magic)) || (magic[0] == 'B' && magic[1] == 'M')) {
+        return; // Missing files are reported by CheckAsset
+    }
+    if (!IsBuiltFileCurrent(GetPreparedImageFile(path), path)) {
+        issues.push_back({ false, node, "node '" + std::string(graph.GetNodeName(node))
+            + "' image is not a BMP and has no current prepared image (compile with --images): " + std::string(file) });
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef STORY_VALIDATOR_H
+#define STORY_VALIDATOR_H
+
+#include "story_graph.h"
+#include <string>
+#include <vector>
+
+// A problem found in a story graph
+struct StoryIssue {
+    bool error;          // Errors fail the build; warnings only fail it when asked to
+    int node;            // Node the issue was found at (StoryGraph::InvalidNode if none)
+    std::string message;
+};
+
+// Checks a loaded story for content bugs that would otherwise only show up
+// while playing: transitions to undefined nodes, option/transition count
+// mismatches, nodes that can never be reached from "start", and image or
+// audio files that do not exist, or images that are not BMPs and have no
+// current prepared image, which the game could not load.
+class StoryValidator {
+public:
+    // assetRoot is the directory the game runs from (asset paths are relative to it)
+    explicit StoryValidator(const std::string& assetRoot);
+
+    // Check the graph and return every issue found
+    std::vector<StoryIssue> Validate(const StoryGraph& graph) const;
+
+private:
+    void CheckAsset(const StoryGraph& graph, int node, std::string_view file, const char* kind, std::vector<StoryIssue>& issues) const;
+    void CheckImageFormat(const StoryGraph& graph, int node, std::vector<StoryIssue>& issues) const;
+
+    std::string assetRoot; // Directory asset paths are resolved against
+};
+
+#endif // STORY_VALIDATOR_H
@@ -0,0 +1,79 @@
+#include "text_layout_cache.h"
+#include <utility>
+
+bool TextLayoutKey::operator==(const TextLayoutKey& other) const {
+    return textHash == other.textHash && font == other.font && fontSize == other.fontSize
+        && color == other.color && maxWidth == other.maxWidth;
+}
+
+size_t TextLayoutCache::KeyHash::operator()(const TextLayoutKey& key) const {
+    // The text hash is already well mixed; fold the rest in
+    uint64_t hash = key.textHash;
+    hash ^= reinterpret_cast<uintptr_t>(key.font) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    hash ^= (static_cast<uint64_t>(key.color) << 32 | static_cast<uint32_t>(key.maxWidth)) + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<uint64_t>(key.fontSize) + (hash << 6) + (hash >> 2);
+    return static_cast<size_t>(hash);
+}
+
+TextLayoutCache::TextLayoutCache(size_t capacity)
+    : capacity(capacity == 0 ? 1 : capacity),
+    hits(0),
+    misses(0),
+    evictions(0)
+{
+}
+
+// Key for text drawn with the given font, size, color and wrap width
+TextLayoutKey TextLayoutCache::MakeKey(std::string_view text, const TTF_Font* font, int fontSize, SDL_Color color, int maxWidth) {
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    uint32_t packedColor = static_cast<uint32_t>(color.r) << 24 | static_cast<uint32_t>(color.g) << 16
+        | static_cast<uint32_t>(color.b) << 8 | color.a;
+    return { hash, font, fontSize, packedColor, maxWidth };
+}
+
+// The cached layout, marked as most recently used, or nullptr
+const TextLayout* TextLayoutCache::Find(const TextLayoutKey& key, std::string_view text) {
+    auto found = index.find(key);
+    if (found == index.end() || found->second->layout.text != text) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, found->second); // Moves the node; no allocation
+    return &found->second->layout;
+}
+
+// Store a layout, evicting the least recently used one if the cache is full
+const TextLayout* TextLayoutCache::Insert(const TextLayoutKey& key, TextLayout&& layout) {
+    auto found = index.find(key);
+    if (found != index.end()) {
+        // Same key with different text (a hash collision): replace it
+        found->second->layout = std::move(layout);
+        entries.splice(entries.begin(), entries, found->second);
+        return &found->second->layout;
+    }
+
+    if (entries.size() >= capacity) {
+        index.erase(entries.back().key);
+        entries.pop_back();
+        ++evictions;
+    }
+    entries.push_front({ key, std::move(layout) });
+    index.emplace(key, entries.begin());
+    return &entries.front().layout;
+}
+
+// Forget every layout
+void TextLayoutCache::Clear() {
+    entries.clear();
+    index.clear();
+}
+
+TextCacheStats TextLayoutCache::GetStats() const {
+    return { hits, misses, evictions, entries.size() };
+}
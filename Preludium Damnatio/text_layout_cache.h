@@ -0,0 +1,83 @@
+#ifndef TEXT_LAYOUT_CACHE_H
+#define TEXT_LAYOUT_CACHE_H
+
+#include "line_breaker.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// What a piece of text was laid out with
+struct TextLayoutKey {
+    uint64_t textHash;
+    const TTF_Font* font;
+    int fontSize;
+    uint32_t color;   // RGBA packed into one word
+    int maxWidth;
+
+    bool operator==(const TextLayoutKey& other) const;
+};
+
+// A piece of text wrapped and turned into glyph atlas quads, with its top
+// left corner at (0, 0)
+struct TextLayout {
+    std::string text;                // Checked on lookup, so a hash collision is only a miss
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    std::vector<LineBreak> lines;    // Where the text was wrapped
+    int height;
+};
+
+// Counters for the text layout cache
+struct TextCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+};
+
+// Least recently used cache of text layouts. A node's text and options come
+// back every time it is redrawn; with their layout cached, redrawing them
+// is a copy of ready-made quads, with no wrapping and no TTF calls.
+class TextLayoutCache {
+public:
+    explicit TextLayoutCache(size_t capacity = 128);
+
+    // Key for text drawn with the given font, size, color and wrap width
+    static TextLayoutKey MakeKey(std::string_view text, const TTF_Font* font, int fontSize, SDL_Color color, int maxWidth);
+
+    // The cached layout, marked as most recently used, or nullptr (counted as a miss)
+    const TextLayout* Find(const TextLayoutKey& key, std::string_view text);
+
+    // Store a layout, evicting the least recently used one if the cache is full
+    const TextLayout* Insert(const TextLayoutKey& key, TextLayout&& layout);
+
+    // Forget every layout (their quads refer to the atlas of the current font)
+    void Clear();
+
+    TextCacheStats GetStats() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const TextLayoutKey& key) const;
+    };
+
+    struct Entry {
+        TextLayoutKey key;
+        TextLayout layout;
+    };
+
+    size_t capacity;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<TextLayoutKey, std::list<Entry>::iterator, KeyHash> index;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+#endif // TEXT_LAYOUT_CACHE_H
@@ -0,0 +1,216 @@
+#include "texture_cache.h"
+#include <iostream>
+#include <utility>
+
+TextureHandle::TextureHandle() : cache(nullptr), entry(nullptr) {}
+
+TextureHandle::TextureHandle(TextureCache* cache, Entry* entry) : cache(cache), entry(entry) {
+    ++entry->references;
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other) : cache(other.cache), entry(other.entry) {
+    if (entry) {
+        ++entry->references;
+    }
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept : cache(other.cache), entry(other.entry) {
+    other.cache = nullptr;
+    other.entry = nullptr;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept {
+    std::swap(cache, other.cache);
+    std::swap(entry, other.entry);
+    return *this;
+}
+
+TextureHandle::~TextureHandle() {
+    Reset();
+}
+
+// Drop the reference
+void TextureHandle::Reset() {
+    if (entry) {
+        cache->Release(entry);
+        cache = nullptr;
+        entry = nullptr;
+    }
+}
+
+SDL_Texture* TextureHandle::Get() const {
+    return entry ? entry->texture : nullptr;
+}
+
+int TextureHandle::GetWidth() const {
+    return entry ? entry->width : 0;
+}
+
+int TextureHandle::GetHeight() const {
+    return entry ? entry->height : 0;
+}
+
+TextureHandle::operator bool() const {
+    return Get() != nullptr;
+}
+
+TextureCache::TextureCache(SDL_Renderer* renderer, ImageDecoder* decoder, size_t budget)
+    : renderer(renderer),
+    decoder(decoder),
+    budget(budget),
+    bytes(0),
+    keepDistance(DefaultKeepDistance),
+    hits(0),
+    misses(0),
+    evictions(0)
+{
+}
+
+TextureCache::~TextureCache() {
+    for (auto& entry : entries) {
+        if (entry.second->texture) {
+            SDL_DestroyTexture(entry.second->texture);
+        }
+    }
+}
+
+// Texture for an image file, loading it on first use
+TextureHandle TextureCache::Acquire(std::string_view file) {
+    auto found = entries.find(file);
+    if (found != entries.end()) {
+        ++hits;
+        Entry* entry = found->second.get();
+        recency.splice(recency.begin(), recency, entry->recency);
+        return TextureHandle(this, entry);
+    }
+
+    ++misses;
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->file = std::string(file);
+    entry->texture = nullptr;
+    entry->width = 0;
+    entry->height = 0;
+    entry->bytes = 0;
+    entry->references = 0;
+    entry->distance = 0; // Just asked for, so as near as the current node
+
+    // Use the decoded image if it was prefetched; only the upload is left
+    SDL_Surface* surface = decoder ? decoder->Take(file) : nullptr;
+    if (surface == nullptr) {
+        surface = LoadImageSurface(entry->file);
+    }
+    if (surface) {
+        entry->texture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (entry->texture) {
+            entry->width = surface->w;
+            entry->height = surface->h;
+            entry->bytes = static_cast<size_t>(surface->w) * surface->h * 4;
+        }
+        SDL_FreeSurface(surface);
+    }
+    if (entry->texture == nullptr) {
+        std::cerr << "Failed to load image: " << entry->file << std::endl;
+    }
+
+    Entry* added = entry.get();
+    recency.push_front(added);
+    added->recency = recency.begin();
+    entries.emplace(std::string_view(added->file), std::move(entry));
+    bytes += added->bytes;
+
+    // Take the reference before trimming, so the new texture is never the one evicted
+    TextureHandle handle(this, added);
+    Trim();
+    return handle;
+}
+
+bool TextureCache::IsResident(std::string_view file) const {
+    return entries.find(file) != entries.end();
+}
+
+// Change the budget, evicting at once if the cache is over it
+void TextureCache::SetBudget(size_t newBudget) {
+    budget = newBudget;
+    Trim();
+}
+
+// Record how far each image is from the current node
+void TextureCache::SetDistances(const std::vector<ImageDistance>& distances) {
+    for (auto& entry : entries) {
+        entry.second->distance = Unreachable;
+    }
+    for (const ImageDistance& distance : distances) {
+        auto found = entries.find(distance.file);
+        if (found != entries.end() && distance.hops < found->second->distance) {
+            found->second->distance = distance.hops; // Several nodes may show the same image
+        }
+    }
+    Trim(); // Textures that were kept may not be any more
+}
+
+// Textures at most this many choices away are kept whatever the budget
+void TextureCache::SetKeepDistance(int hops) {
+    keepDistance = hops;
+    Trim();
+}
+
+// Destroy every texture no handle refers to
+void TextureCache::Clear() {
+    for (auto entry = recency.begin(); entry != recency.end();) {
+        Entry* current = *entry++;
+        if (current->references == 0) {
+            Unload(current);
+        }
+    }
+}
+
+TextureCacheStats TextureCache::GetStats() const {
+    return { hits, misses, evictions, entries.size(), bytes, budget };
+}
+
+void TextureCache::Release(Entry* entry) {
+    --entry->references;
+    if (entry->references == 0 && bytes > budget) {
+        Trim();
+    }
+}
+
+// Evict textures until the cache fits its budget, farthest from the current node first
+void TextureCache::Trim() {
+    while (bytes > budget) {
+        Entry* victim = FindVictim();
+        if (victim == nullptr) {
+            break; // Everything left is in use or near
+        }
+        Unload(victim);
+        ++evictions;
+    }
+}
+
+// The farthest texture beyond the keep distance that no handle refers to,
+// the least recently used of those equally far (nullptr if there is none)
+TextureCache::Entry* TextureCache::FindVictim() const {
+    Entry* victim = nullptr;
+    for (auto entry = recency.rbegin(); entry != recency.rend(); ++entry) {
+        Entry* current = *entry;
+        if (current->references > 0 || current->bytes == 0 || current->distance <= keepDistance) {
+            continue; // In use, a failed load that costs nothing to remember, or near
+        }
+        if (victim == nullptr || current->distance > victim->distance) {
+            victim = current;
+            if (victim->distance == Unreachable) {
+                break; // Nothing is farther, and the rest were used more recently
+            }
+        }
+    }
+    return victim;
+}
+
+void TextureCache::Unload(Entry* entry) {
+    if (entry->texture) {
+        SDL_DestroyTexture(entry->texture);
+    }
+    bytes -= entry->bytes;
+    recency.erase(entry->recency);
+    entries.erase(entries.find(std::string_view(entry->file))); // Destroys the entry
+}
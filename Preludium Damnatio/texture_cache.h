@@ -0,0 +1,141 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "image_decoder.h"
+#include <cstddef>
+#include <climits>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <SDL.h>
+
+class TextureCache;
+
+// Counted reference to a texture in a TextureCache. While any handle to a
+// texture exists it is never evicted. Handles must not outlive their cache.
+class TextureHandle {
+public:
+    TextureHandle();
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other) noexcept;
+    TextureHandle& operator=(TextureHandle other) noexcept;
+    ~TextureHandle();
+
+    // Drop the reference (the texture stays cached until it is evicted)
+    void Reset();
+
+    SDL_Texture* Get() const;
+    int GetWidth() const;
+    int GetHeight() const;
+
+    // False for an empty handle or an image that failed to load
+    explicit operator bool() const;
+
+private:
+    friend class TextureCache;
+    struct Entry;
+
+    TextureHandle(TextureCache* cache, Entry* entry);
+
+    TextureCache* cache;
+    Entry* entry;
+};
+
+// How many choices away from the current node an image is shown
+struct ImageDistance {
+    std::string_view file;
+    int hops;
+};
+
+// Counters for the texture cache
+struct TextureCacheStats {
+    uint64_t hits;
+    uint64_t misses;     // Images loaded from disk
+    uint64_t evictions;
+    size_t textures;     // Textures resident
+    size_t bytes;        // Their estimated size (4 bytes per pixel)
+    size_t budget;
+};
+
+// Keeps node images resident as textures across frames and revisits, so a
+// redraw is one SDL_RenderCopy instead of reading and decoding a BMP. Each
+// texture is counted at 4 bytes per pixel against a byte budget; when the
+// total goes over it, textures that no handle refers to are destroyed,
+// those farthest from the current node in the story graph first and the
+// least recently used among equally far ones. Textures within the keep
+// distance are never evicted, so moving back and forth between nearby
+// nodes does not thrash. Images that fail to load are remembered too, so
+// a missing file is not retried on every frame. Images the decoder has
+// already decoded in the background are only uploaded.
+class TextureCache {
+public:
+    static const size_t DefaultBudget = 256 * 1024 * 1024;
+    static const int DefaultKeepDistance = 2;
+    static const int Unreachable = INT_MAX; // Distance of images not reachable from the current node
+
+    explicit TextureCache(SDL_Renderer* renderer, ImageDecoder* decoder = nullptr, size_t budget = DefaultBudget);
+    ~TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Texture for an image file, loading it on first use
+    TextureHandle Acquire(std::string_view file);
+
+    // Whether the texture for an image file is loaded (or known to fail)
+    bool IsResident(std::string_view file) const;
+
+    // Change the budget, evicting at once if the cache is over it
+    void SetBudget(size_t bytes);
+
+    // Record how far each image is from the current node; images not listed
+    // are taken to be unreachable. Textures loaded later count as 0 hops away
+    // until the next call.
+    void SetDistances(const std::vector<ImageDistance>& distances);
+
+    // Textures at most this many choices away are kept whatever the budget
+    void SetKeepDistance(int hops);
+
+    // Destroy every texture no handle refers to; call before the renderer is destroyed
+    void Clear();
+
+    TextureCacheStats GetStats() const;
+
+private:
+    friend class TextureHandle;
+    using Entry = TextureHandle::Entry;
+
+    void Release(Entry* entry);
+    void Trim();
+    Entry* FindVictim() const;
+    void Unload(Entry* entry);
+
+    SDL_Renderer* renderer;
+    ImageDecoder* decoder; // Prefetched images, or nullptr
+    size_t budget;
+    size_t bytes;
+    int keepDistance;
+    std::unordered_map<std::string_view, std::unique_ptr<Entry>> entries; // Keys point into each entry's file
+    std::list<Entry*> recency; // Most recently used first
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+// A cached texture
+struct TextureHandle::Entry {
+    std::string file;
+    SDL_Texture* texture; // nullptr if the image failed to load
+    int width;
+    int height;
+    size_t bytes;
+    int references;       // Handles pointing at this entry
+    int distance;         // Choices from the current node to a node showing it
+    std::list<Entry*>::iterator recency;
+};
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,147 @@
+// Headless turn-throughput benchmark for the story engine. Plays the story
+// with a choice policy and no window, restarting whenever a game ends, and
+// reports turns per second, per-turn latency percentiles and heap
+// allocations per turn. Use it as the baseline for engine changes.
+//
+// Usage: "Story Benchmark" [--turns N] [--policy random|roundrobin|scripted:1,2,3] [--seed N] [--story file]
+#define SDL_MAIN_HANDLED
+#include "story_manager.h"
+#include "autoplay_driver.h"
+#include "choice_policy.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+    std::atomic<unsigned long long> allocationCount(0); // Calls to operator new since startup
+
+    using Clock = std::chrono::steady_clock;
+
+    void PrintUsage() {
+        std::cerr << "Usage: StoryBenchmark [--turns N] [--policy random|roundrobin|scripted:1,2,3] [--seed N] [--story file]" << std::endl;
+    }
+
+    // Make one choice, starting a new game first if the last one ended
+    void BenchmarkTurn(StoryManager& storyManager, AutoplayDriver& driver) {
+        if (storyManager.IsGameOver()) {
+            storyManager.Restart();
+        }
+        driver.PlayTurn();
+    }
+}
+
+// Count every heap allocation made by the process
+void* operator new(std::size_t size) {
+    ++allocationCount;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+int main(int argc, char* argv[]) {
+    int turns = 1000000;
+    std::string policyName = "random";
+    unsigned int seed = 1;
+    std::string storyFile = "assets/stories/preludium damnatio.story";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--turns" && i + 1 < argc) {
+            turns = std::atoi(argv[++i]);
+        }
+        else if (arg == "--policy" && i + 1 < argc) {
+            policyName = argv[++i];
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--story" && i + 1 < argc) {
+            storyFile = argv[++i];
+        }
+        else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (turns < 1) {
+        PrintUsage();
+        return 2;
+    }
+
+    std::unique_ptr<ChoicePolicy> policy = CreateChoicePolicy(policyName, seed);
+    if (!policy) {
+        std::cerr << "Unknown choice policy: " << policyName << std::endl;
+        return 2;
+    }
+
+    // A RenderManager without a renderer makes every draw a no-op, so only engine work is measured
+    InputManager inputManager;
+    RenderManager renderManager(nullptr);
+    StoryManager storyManager(inputManager, renderManager);
+    if (!storyManager.LoadStory(storyFile)) {
+        return 1;
+    }
+    storyManager.SetRandomSeed(seed);
+    AutoplayDriver driver(storyManager, *policy);
+
+    // Warm up caches and the allocator
+    for (int i = 0; i < 10000; ++i) {
+        BenchmarkTurn(storyManager, driver);
+    }
+
+    // Throughput pass: no per-turn timing
+    unsigned long long allocationsBefore = allocationCount.load();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < turns; ++i) {
+        BenchmarkTurn(storyManager, driver);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    unsigned long long allocations = allocationCount.load() - allocationsBefore;
+
+    // Latency pass: time every turn individually
+    std::vector<long long> latencies(static_cast<size_t>(turns));
+    for (int i = 0; i < turns; ++i) {
+        Clock::time_point turnStart = Clock::now();
+        BenchmarkTurn(storyManager, driver);
+        latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - turnStart).count();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double fraction) {
+        size_t index = static_cast<size_t>(fraction * (latencies.size() - 1));
+        return latencies[index];
+    };
+
+    std::cout << "Story: " << storyFile << ", policy: " << policyName << ", seed: " << seed << std::endl;
+    std::cout << "Turns: " << turns << " in " << seconds << " s (" << (turns / seconds) << " turns/s)" << std::endl;
+    std::cout << "Latency per turn (ns): p50 " << percentile(0.50) << ", p90 " << percentile(0.90)
+        << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999) << ", max " << latencies.back() << std::endl;
+    std::cout << "Allocations per turn: " << static_cast<double>(allocations) / turns << std::endl;
+    return 0;
+}
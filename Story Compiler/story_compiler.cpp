@@ -0,0 +1,157 @@
+// Offline story compiler: validates .story sources and writes the compiled
+// .storyc form that the game maps at startup.
+//
+// Usage: "Story Compiler" [options] <story file>...
+//   -o <file>       output file (only with a single input; default is <input>c)
+//   --root <dir>    directory the game runs from, used to check asset paths (default ".")
+//   --werror        treat warnings as errors
+//   --images        also write every node image as a prepared image (<image>.pimg
+//                   under the root), scaled to the size the game draws it at
+//   --image-size <width>x<height>  size of the prepared images (default 1200x800)
+#include "story_graph.h"
+#include "story_loader.h"
+#include "story_validator.h"
+#include "image_source.h"
+#include "prepared_image.h"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+    void PrintUsage() {
+        std::cerr << "Usage: StoryCompiler [-o output.storyc] [--root <asset dir>] [--werror] [--images] [--image-size WxH] <story file>..." << std::endl;
+    }
+
+    // Decode, scale and write the prepared form of every image the story shows
+    bool PrepareImages(const StoryGraph& graph, const std::string& assetRoot, int width, int height) {
+        std::set<std::string> images;
+        for (int node = 0; node < graph.GetNodeCount(); ++node) {
+            if (graph.IsDefined(node) && !graph.GetImageFile(node).empty()) {
+                images.insert(std::string(graph.GetImageFile(node)));
+            }
+        }
+
+        bool succeeded = true;
+        for (const std::string& image : images) {
+            std::string source = assetRoot + "/" + image;
+            std::error_code error;
+            if (!std::filesystem::is_regular_file(source, error)) {
+                continue; // Missing images are reported by the validator
+            }
+
+            PixelImage pixels;
+            if (!LoadSourceImage(source, pixels)) {
+                succeeded = false; // The decoder has already reported the error
+                continue;
+            }
+            if (pixels.width != width || pixels.height != height) {
+                pixels = ScaleImage(pixels, width, height);
+            }
+
+            std::string prepared = GetPreparedImageFile(source);
+            if (!SavePreparedImage(prepared, pixels)) {
+                succeeded = false;
+                continue;
+            }
+            std::cout << source << " -> " << prepared << std::endl;
+        }
+        return succeeded;
+    }
+
+    // Load, validate and compile one story; returns false if it must fail the build
+    bool CompileStory(const std::string& input, const std::string& output, const StoryValidator& validator, bool warningsAreErrors,
+        bool prepareImages, const std::string& assetRoot, int imageWidth, int imageHeight) {
+        StoryGraph graph;
+        StoryLoader loader;
+        if (!loader.LoadFile(input, graph)) {
+            return false; // The loader has already reported the error
+        }
+
+        // Prepare the images first, so the validator sees which ones the game can load
+        bool imagesPrepared = !prepareImages || PrepareImages(graph, assetRoot, imageWidth, imageHeight);
+
+        int errorCount = 0;
+        int warningCount = 0;
+        for (const StoryIssue& issue : validator.Validate(graph)) {
+            bool isError = issue.error || warningsAreErrors;
+            std::cerr << input << ": " << (isError ? "error: " : "warning: ") << issue.message << std::endl;
+            if (isError) {
+                ++errorCount;
+            }
+            else {
+                ++warningCount;
+            }
+        }
+
+        if (errorCount > 0) {
+            std::cerr << input << ": " << errorCount << " error(s), " << warningCount << " warning(s); not compiled" << std::endl;
+            return false;
+        }
+
+        if (!graph.SaveCompiled(output)) {
+            return false;
+        }
+
+        std::cout << input << " -> " << output << " (" << graph.GetNodeCount() << " nodes, "
+            << warningCount << " warning(s))" << std::endl;
+        return imagesPrepared;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> inputs;
+    std::string output;
+    std::string assetRoot = ".";
+    bool warningsAreErrors = false;
+    bool prepareImages = false;
+    int imageWidth = 1200;
+    int imageHeight = 800;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (arg == "--root" && i + 1 < argc) {
+            assetRoot = argv[++i];
+        }
+        else if (arg == "--werror") {
+            warningsAreErrors = true;
+        }
+        else if (arg == "--images") {
+            prepareImages = true;
+        }
+        else if (arg == "--image-size" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &imageWidth, &imageHeight) != 2 || imageWidth <= 0 || imageHeight <= 0) {
+                PrintUsage();
+                return 2;
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            PrintUsage();
+            return 2;
+        }
+        else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty() || (!output.empty() && inputs.size() > 1)) {
+        PrintUsage();
+        return 2;
+    }
+
+    StoryValidator validator(assetRoot);
+    bool succeeded = true;
+    for (const std::string& input : inputs) {
+        std::string target = output.empty() ? input + "c" : output;
+        if (!CompileStory(input, target, validator, warningsAreErrors, prepareImages, assetRoot, imageWidth, imageHeight)) {
+            succeeded = false;
+        }
+    }
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,485 @@
+#include "path_explorer.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+    const uint32_t NoLength = std::numeric_limits<uint32_t>::max();
+
+    uint64_t SaturatingAdd(uint64_t a, uint64_t b) {
+        return a > std::numeric_limits<uint64_t>::max() - b ? std::numeric_limits<uint64_t>::max() : a + b;
+    }
+}
+
+// A sub-tree to search: the path that leads to it and the choices to try at its last node
+struct PathExplorer::Task {
+    std::vector<int> prefix;
+    int firstChoice;
+    int lastChoice;
+};
+
+struct PathExplorer::Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;          // Owner pops from the back, thieves from the front
+    std::atomic<int> queued{ 0 };
+    std::vector<int> visits;         // Times each node appears on the current path
+    std::vector<EndingStats> endings;
+    uint64_t truncatedPaths = 0;
+    uint64_t stolenTasks = 0;
+    std::minstd_rand random;
+};
+
+PathExplorer::PathExplorer(const StoryGraph& graph, int visitLimit, int threadCount)
+    : graph(graph),
+    visitLimit(std::max(1, visitLimit)),
+    threadCount(std::max(1, threadCount)),
+    startNode(graph.FindNode("start")),
+    endNode(graph.FindNode("end_game")),
+    encounterNode(graph.FindNode("random_encounter")),
+    pendingTasks(0),
+    idleWorkers(0)
+{
+}
+
+ExplorationResult PathExplorer::Explore() {
+    ExplorationResult result = {};
+    encounterNodes.clear();
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (graph.IsDefined(node) && graph.GetEncounterWeight(node) > 0) {
+            encounterNodes.push_back(node);
+        }
+    }
+    FindEndings();
+
+    // Branching factor over defined nodes
+    int definedNodes = 0;
+    long long totalChoices = 0;
+    result.minChoices = std::numeric_limits<int>::max();
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (!graph.IsDefined(node)) {
+            continue;
+        }
+        int choices = ChoiceCount(node);
+        ++definedNodes;
+        totalChoices += choices;
+        result.minChoices = std::min(result.minChoices, choices);
+        result.maxChoices = std::max(result.maxChoices, choices);
+        if (choices > 1) {
+            ++result.decisionNodes;
+        }
+    }
+    if (definedNodes == 0) {
+        result.minChoices = 0;
+    }
+    result.meanChoices = definedNodes > 0 ? static_cast<double>(totalChoices) / definedNodes : 0.0;
+
+    for (int node : endingNodes) {
+        result.endings.push_back({ node, 0, NoLength, 0, {}, {} });
+    }
+    if (!graph.IsDefined(startNode)) {
+        return result;
+    }
+
+    BuildSummaries();
+    result.memoizedNodes = 0;
+    for (int index : summaryIndex) {
+        if (index >= 0) {
+            ++result.memoizedNodes;
+        }
+    }
+
+    // A story without cycles is answered entirely by the summaries
+    if (summaryIndex[startNode] >= 0) {
+        for (size_t slot = 0; slot < endingNodes.size(); ++slot) {
+            const Summary& summary = summaries[summaryIndex[startNode] + slot];
+            EndingStats& stats = result.endings[slot];
+            stats.paths = summary.count;
+            if (summary.count > 0) {
+                stats.shortest = summary.shortest;
+                stats.longest = summary.longest;
+                AppendSummaryRoute(stats.shortestRoute, startNode, static_cast<int>(slot), true);
+                AppendSummaryRoute(stats.longestRoute, startNode, static_cast<int>(slot), false);
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::unique_ptr<Worker>> pool;
+    for (int i = 0; i < threadCount; ++i) {
+        pool.emplace_back(new Worker());
+        pool.back()->visits.assign(graph.GetNodeCount(), 0);
+        pool.back()->endings = result.endings;
+        pool.back()->random.seed(static_cast<unsigned>(i) + 1);
+        workers.push_back(pool.back().get());
+    }
+
+    pendingTasks = 1;
+    idleWorkers = 0;
+    pool[0]->tasks.push_back({ { startNode }, 0, ChoiceCount(startNode) });
+    pool[0]->queued = 1;
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(&PathExplorer::Run, this, std::ref(*pool[i]));
+    }
+    Run(*pool[0]);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // Merge the per-thread results
+    for (const auto& worker : pool) {
+        result.truncatedPaths += worker->truncatedPaths;
+        result.stolenTasks += worker->stolenTasks;
+        for (size_t slot = 0; slot < result.endings.size(); ++slot) {
+            EndingStats& total = result.endings[slot];
+            const EndingStats& part = worker->endings[slot];
+            total.paths = SaturatingAdd(total.paths, part.paths);
+            if (part.shortest < total.shortest) {
+                total.shortest = part.shortest;
+                total.shortestRoute = part.shortestRoute;
+            }
+            if (part.paths > 0 && (total.longestRoute.empty() || part.longest > total.longest)) {
+                total.longest = part.longest;
+                total.longestRoute = part.longestRoute;
+            }
+        }
+    }
+    workers.clear();
+    return result;
+}
+
+// A choice ends the game when it leads to "end_game" or to a node that was never
+// defined ("random_encounter" is only terminal if the story has no encounters)
+bool PathExplorer::IsTerminal(int node) const {
+    if (node == encounterNode && !encounterNodes.empty()) {
+        return false;
+    }
+    return node == endNode || !graph.IsDefined(node);
+}
+
+// "random_encounter" branches to every encounter node, as if each were a choice
+int PathExplorer::ChoiceCount(int node) const {
+    if (node == encounterNode) {
+        return static_cast<int>(encounterNodes.size());
+    }
+    return graph.GetChoiceCount(node);
+}
+
+int PathExplorer::NextNode(int node, int choice) const {
+    if (node == encounterNode) {
+        return encounterNodes[choice];
+    }
+    return graph.GetNextNode(node, choice);
+}
+
+// An ending is a node that has no choices, or has a choice that ends the game
+void PathExplorer::FindEndings() {
+    endingIndex.assign(graph.GetNodeCount(), -1);
+    endingNodes.clear();
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (!graph.IsDefined(node)) {
+            continue;
+        }
+        bool ending = ChoiceCount(node) == 0;
+        for (int choice = 0; choice < ChoiceCount(node) && !ending; ++choice) {
+            ending = IsTerminal(NextNode(node, choice));
+        }
+        if (ending) {
+            endingIndex[node] = static_cast<int>(endingNodes.size());
+            endingNodes.push_back(node);
+        }
+    }
+}
+
+// Summarise every node whose reachable subgraph is acyclic. Tarjan's algorithm
+// emits strongly connected components in reverse topological order, so a
+// node's successors are always summarised before the node itself.
+void PathExplorer::BuildSummaries() {
+    int nodeCount = graph.GetNodeCount();
+    size_t endingCount = endingNodes.size();
+    summaryIndex.assign(nodeCount, -1);
+    summaries.clear();
+
+    std::vector<int> order(nodeCount, -1);
+    std::vector<int> lowLink(nodeCount, 0);
+    std::vector<char> onStack(nodeCount, 0);
+    std::vector<int> componentStack;
+    std::vector<std::pair<int, int>> callStack; // (node, next choice to visit)
+    int nextOrder = 0;
+
+    order[startNode] = lowLink[startNode] = nextOrder++;
+    componentStack.push_back(startNode);
+    onStack[startNode] = 1;
+    callStack.push_back({ startNode, 0 });
+
+    while (!callStack.empty()) {
+        int node = callStack.back().first;
+        int& choice = callStack.back().second;
+
+        if (choice < ChoiceCount(node)) {
+            int target = NextNode(node, choice++);
+            if (IsTerminal(target)) {
+                continue;
+            }
+            if (order[target] < 0) {
+                order[target] = lowLink[target] = nextOrder++;
+                componentStack.push_back(target);
+                onStack[target] = 1;
+                callStack.push_back({ target, 0 });
+            }
+            else if (onStack[target]) {
+                lowLink[node] = std::min(lowLink[node], order[target]);
+            }
+            continue;
+        }
+
+        callStack.pop_back();
+        if (!callStack.empty()) {
+            int parent = callStack.back().first;
+            lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+        }
+        if (lowLink[node] != order[node]) {
+            continue;
+        }
+
+        // node is the root of a component; pop it
+        bool trivial = componentStack.back() == node;
+        while (true) {
+            int member = componentStack.back();
+            componentStack.pop_back();
+            onStack[member] = 0;
+            if (member == node) {
+                break;
+            }
+        }
+
+        bool summarise = trivial;
+        for (int c = 0; c < ChoiceCount(node) && summarise; ++c) {
+            int target = NextNode(node, c);
+            summarise = IsTerminal(target) || summaryIndex[target] >= 0; // Also rejects self-loops
+        }
+        if (!summarise) {
+            continue;
+        }
+
+        int base = static_cast<int>(summaries.size());
+        summaries.resize(summaries.size() + endingCount, { 0, NoLength, 0, -1, -1 });
+        if (endingIndex[node] >= 0 && ChoiceCount(node) == 0) {
+            summaries[base + endingIndex[node]] = { 1, 0, 0, -1, -1 };
+        }
+
+        for (int c = 0; c < ChoiceCount(node); ++c) {
+            int target = NextNode(node, c);
+            if (IsTerminal(target)) {
+                Summary& own = summaries[base + endingIndex[node]];
+                own.count = SaturatingAdd(own.count, 1);
+                if (1 < own.shortest) {
+                    own.shortest = 1;
+                    own.shortestChoice = c;
+                }
+                if (own.longestChoice < 0 || 1 > own.longest) {
+                    own.longest = 1;
+                    own.longestChoice = c;
+                }
+                continue;
+            }
+
+            for (size_t slot = 0; slot < endingCount; ++slot) {
+                const Summary& next = summaries[summaryIndex[target] + slot];
+                if (next.count == 0) {
+                    continue;
+                }
+                Summary& own = summaries[base + slot];
+                own.count = SaturatingAdd(own.count, next.count);
+                if (next.shortest + 1 < own.shortest) {
+                    own.shortest = next.shortest + 1;
+                    own.shortestChoice = c;
+                }
+                if (own.longestChoice < 0 || next.longest + 1 > own.longest) {
+                    own.longest = next.longest + 1;
+                    own.longestChoice = c;
+                }
+            }
+        }
+        summaryIndex[node] = base;
+    }
+}
+
+void PathExplorer::Run(Worker& worker) {
+    Task task;
+    while (true) {
+        if (PopTask(worker, task)) {
+            ExploreTask(worker, task);
+            --pendingTasks;
+            continue;
+        }
+
+        // Out of local work: steal the oldest (shallowest) task from another thread
+        ++idleWorkers;
+        bool stole = false;
+        while (!stole) {
+            if (pendingTasks.load() == 0) {
+                --idleWorkers;
+                return;
+            }
+
+            size_t offset = worker.random() % workers.size();
+            for (size_t i = 0; i < workers.size() && !stole; ++i) {
+                Worker& victim = *workers[(offset + i) % workers.size()];
+                if (&victim == &worker || victim.queued.load(std::memory_order_relaxed) == 0) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    --victim.queued;
+                    stole = true;
+                }
+            }
+
+            if (!stole) {
+                std::this_thread::yield();
+            }
+        }
+        --idleWorkers;
+        ++worker.stolenTasks;
+        ExploreTask(worker, task);
+        --pendingTasks;
+    }
+}
+
+bool PathExplorer::PopTask(Worker& worker, Task& task) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    --worker.queued;
+    return true;
+}
+
+// Depth-first search of one task's sub-tree
+void PathExplorer::ExploreTask(Worker& worker, const Task& task) {
+    struct Frame {
+        int node;
+        int nextChoice;
+        int lastChoice;
+    };
+
+    std::vector<int> path = task.prefix;
+    for (int node : path) {
+        ++worker.visits[node];
+    }
+    size_t rootDepth = path.size() - 1; // path index of the task's root node
+
+    std::vector<Frame> frames;
+    frames.push_back({ path.back(), task.firstChoice, task.lastChoice });
+
+    while (!frames.empty()) {
+        Frame& frame = frames.back();
+        if (frame.nextChoice == frame.lastChoice) {
+            if (frames.size() > 1) {
+                --worker.visits[frame.node];
+                path.pop_back();
+            }
+            frames.pop_back();
+            continue;
+        }
+
+        int node = frame.node;
+        int choice = frame.nextChoice++;
+
+        // Another thread is idle and nothing is queued here: hand over the shallowest untried branches
+        if (idleWorkers.load(std::memory_order_relaxed) > 0 && worker.queued.load(std::memory_order_relaxed) == 0) {
+            for (size_t depth = 0; depth < frames.size(); ++depth) {
+                Frame& donor = frames[depth];
+                if (donor.nextChoice == donor.lastChoice) {
+                    continue;
+                }
+                std::vector<int> prefix(path.begin(), path.begin() + rootDepth + depth + 1);
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                for (int c = donor.nextChoice; c < donor.lastChoice; ++c) {
+                    ++pendingTasks;
+                    worker.tasks.push_back({ prefix, c, c + 1 });
+                    ++worker.queued;
+                }
+                donor.nextChoice = donor.lastChoice;
+                break;
+            }
+        }
+
+        int target = NextNode(node, choice);
+        uint32_t length = static_cast<uint32_t>(path.size()); // Choices made including this one
+
+        if (IsTerminal(target)) {
+            RecordPath(worker, path, endingIndex[node], 1, length, length, -1);
+        }
+        else if (summaryIndex[target] >= 0) {
+            for (size_t slot = 0; slot < endingNodes.size(); ++slot) {
+                const Summary& summary = summaries[summaryIndex[target] + slot];
+                if (summary.count > 0) {
+                    RecordPath(worker, path, static_cast<int>(slot), summary.count, length + summary.shortest, length + summary.longest, target);
+                }
+            }
+        }
+        else if (worker.visits[target] >= visitLimit) {
+            ++worker.truncatedPaths;
+        }
+        else {
+            ++worker.visits[target];
+            path.push_back(target);
+            frames.push_back({ target, 0, ChoiceCount(target) });
+        }
+    }
+
+    for (int node : task.prefix) {
+        --worker.visits[node];
+    }
+}
+
+// Count playthroughs ending at an ending slot; via is the summarised node they continue through (-1 if none)
+void PathExplorer::RecordPath(Worker& worker, const std::vector<int>& path, int slot, uint64_t count, uint32_t shortest, uint32_t longest, int via) {
+    EndingStats& stats = worker.endings[slot];
+    bool first = stats.paths == 0;
+    stats.paths = SaturatingAdd(stats.paths, count);
+
+    if (shortest < stats.shortest) {
+        stats.shortest = shortest;
+        stats.shortestRoute = path;
+        if (via >= 0) {
+            AppendSummaryRoute(stats.shortestRoute, via, slot, true);
+        }
+    }
+    if (first || longest > stats.longest) {
+        stats.longest = longest;
+        stats.longestRoute = path;
+        if (via >= 0) {
+            AppendSummaryRoute(stats.longestRoute, via, slot, false);
+        }
+    }
+}
+
+// Follow the recorded best choices from a summarised node down to the ending
+void PathExplorer::AppendSummaryRoute(std::vector<int>& route, int node, int slot, bool shortest) const {
+    while (true) {
+        route.push_back(node);
+        const Summary& summary = summaries[summaryIndex[node] + slot];
+        int choice = shortest ? summary.shortestChoice : summary.longestChoice;
+        if (choice < 0) {
+            return;
+        }
+        int target = NextNode(node, choice);
+        if (IsTerminal(target)) {
+            return;
+        }
+        node = target;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef PATH_EXPLORER_H
+#define PATH_EXPLORER_H
+
+#include "story_graph.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Playthroughs that finish at one ending node
+struct EndingStats {
+    int node;                    // Ending node (the last node shown before the game ends)
+    uint64_t paths;              // Number of distinct playthroughs (saturates at UINT64_MAX)
+    uint32_t shortest;           // Fewest choices needed to finish here
+    uint32_t longest;            // Most choices made on any counted playthrough
+    std::vector<int> shortestRoute; // Nodes visited on a shortest playthrough
+    std::vector<int> longestRoute;  // Nodes visited on a longest playthrough
+};
+
+// Result of exploring every playthrough of a story
+struct ExplorationResult {
+    std::vector<EndingStats> endings;
+    uint64_t truncatedPaths;     // Paths cut off by the visit limit
+    uint64_t stolenTasks;        // Work items taken from another thread's queue
+    int memoizedNodes;           // Nodes whose sub-path counts were computed once up front
+
+    // Branching factor over defined nodes
+    int minChoices;
+    int maxChoices;
+    double meanChoices;
+    int decisionNodes;           // Nodes offering more than one choice
+};
+
+// Enumerates every playthrough from "start" to an ending. A playthrough ends
+// when a choice leads to "end_game" (or any undefined node) or reaches a node
+// with no choices. A choice leading to "random_encounter" branches to every
+// encounter node. Cycles are bounded by visiting each node at most visitLimit
+// times per playthrough.
+//
+// Nodes whose reachable subgraph has no cycles are summarised once, bottom-up,
+// and the search stops at them. The rest is searched depth-first by a pool of
+// threads; each thread owns a queue of pending sub-trees, and when another
+// thread runs dry the owner hands over its shallowest untried branches for
+// the idle thread to steal.
+class PathExplorer {
+public:
+    PathExplorer(const StoryGraph& graph, int visitLimit, int threadCount);
+
+    ExplorationResult Explore();
+
+private:
+    // Playthroughs from one summarised node to one ending
+    struct Summary {
+        uint64_t count;
+        uint32_t shortest;
+        uint32_t longest;
+        int shortestChoice; // Choice taken first on a shortest path (-1 if the node itself ends the game)
+        int longestChoice;
+    };
+
+    struct Task;
+    struct Worker;
+
+    void FindEndings();
+    void BuildSummaries();
+    void Run(Worker& worker);
+    void ExploreTask(Worker& worker, const Task& task);
+    bool PopTask(Worker& worker, Task& task);
+    void RecordPath(Worker& worker, const std::vector<int>& path, int slot, uint64_t count, uint32_t shortest, uint32_t longest, int via);
+    void AppendSummaryRoute(std::vector<int>& route, int node, int ending, bool shortest) const;
+    bool IsTerminal(int node) const;
+    int ChoiceCount(int node) const;
+    int NextNode(int node, int choice) const;
+
+    const StoryGraph& graph;
+    int visitLimit;
+    int threadCount;
+    int startNode;
+    int endNode;
+    int encounterNode;                // "random_encounter" marker (InvalidNode if the story has none)
+
+    std::vector<int> encounterNodes;  // Nodes a "random_encounter" transition can lead to
+    std::vector<int> endingIndex;    // Node -> ending slot (-1 if the node is not an ending)
+    std::vector<int> endingNodes;    // Ending slot -> node
+    std::vector<int> summaryIndex;   // Node -> first entry in summaries (-1 if not summarised)
+    std::vector<Summary> summaries;  // One entry per (summarised node, ending)
+    std::vector<Worker*> workers;
+    std::atomic<int64_t> pendingTasks; // Tasks queued or running
+    std::atomic<int> idleWorkers;      // Threads looking for something to steal
+};
+
+#endif // PATH_EXPLORER_H
@@ -0,0 +1,107 @@
+// Headless story QA tool: enumerates every playthrough of a story and reports
+// how many paths reach each ending, the shortest and longest routes, and
+// branching statistics. Option conditions are not evaluated, so the counts
+// are an upper bound for stories with variables.
+//
+// Usage: "Story Explorer" [--visits N] [--threads N] <story file>
+//   --visits N    times a node may appear on one playthrough (default 2)
+//   --threads N   worker threads (default: all cores)
+#include "path_explorer.h"
+#include "story_graph.h"
+#include "story_loader.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+
+namespace {
+    void PrintUsage() {
+        std::cerr << "Usage: StoryExplorer [--visits N] [--threads N] <story file>" << std::endl;
+    }
+
+    void PrintRoute(const StoryGraph& graph, const std::vector<int>& route) {
+        for (size_t i = 0; i < route.size(); ++i) {
+            std::cout << (i == 0 ? "      " : " -> ") << graph.GetNodeName(route[i]);
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string storyFile;
+    int visitLimit = 2;
+    int threadCount = static_cast<int>(std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--visits" && i + 1 < argc) {
+            visitLimit = std::atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threadCount = std::atoi(argv[++i]);
+        }
+        else if (!arg.empty() && arg[0] != '-' && storyFile.empty()) {
+            storyFile = arg;
+        }
+        else {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    if (storyFile.empty() || visitLimit < 1) {
+        PrintUsage();
+        return 2;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+
+    StoryGraph graph;
+    StoryLoader loader;
+    if (!loader.Open(storyFile, graph)) {
+        return 1;
+    }
+    if (!graph.IsDefined(graph.FindNode("start"))) {
+        std::cerr << storyFile << ": story has no \"start\" node" << std::endl;
+        return 1;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    PathExplorer explorer(graph, visitLimit, threadCount);
+    ExplorationResult result = explorer.Explore();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << storyFile << ": " << graph.GetNodeCount() << " nodes, visit limit " << visitLimit
+        << ", " << threadCount << " thread(s), " << seconds << " s" << std::endl;
+    std::cout << "Branching: min " << result.minChoices << ", max " << result.maxChoices
+        << ", mean " << result.meanChoices << ", " << result.decisionNodes << " decision node(s)" << std::endl;
+    std::cout << "Memoized nodes: " << result.memoizedNodes << ", stolen tasks: " << result.stolenTasks
+        << ", paths cut by visit limit: " << result.truncatedPaths << std::endl;
+    if (graph.GetVariableCount() > 0) {
+        // Every option is followed whether or not its condition could hold
+        std::cout << "Story has " << graph.GetVariableCount() << " variable(s); option conditions are ignored, "
+            << "so playthrough counts are an upper bound" << std::endl;
+    }
+
+    for (const EndingStats& ending : result.endings) {
+        std::cout << "Ending '" << graph.GetNodeName(ending.node) << "': ";
+        if (ending.paths == 0) {
+            std::cout << "no playthroughs" << std::endl;
+            continue;
+        }
+        if (ending.paths == std::numeric_limits<uint64_t>::max()) {
+            std::cout << "at least ";
+        }
+        std::cout << ending.paths << " playthrough(s), shortest " << ending.shortest
+            << " choices, longest " << ending.longest << " choices" << std::endl;
+        std::cout << "    shortest:" << std::endl;
+        PrintRoute(graph, ending.shortestRoute);
+        std::cout << "    longest:" << std::endl;
+        PrintRoute(graph, ending.longestRoute);
+    }
+
+    return 0;
+}
@@ -0,0 +1,440 @@
+#include "epoll_server.h"
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    // epoll data of the listening socket and the eventfd (connections use their id)
+    const uint64_t ListenEvent = UINT64_MAX;
+    const uint64_t WakeEvent = UINT64_MAX - 1;
+
+    // Longest command line a client may send
+    const size_t MaxLineLength = 256;
+
+    // Next space separated word of line, starting at position
+    bool NextWord(const std::string& line, size_t& position, std::string& word) {
+        while (position < line.size() && line[position] == ' ') {
+            ++position;
+        }
+        size_t start = position;
+        while (position < line.size() && line[position] != ' ') {
+            ++position;
+        }
+        word.assign(line, start, position - start);
+        return !word.empty();
+    }
+
+    bool ParseNumber(const std::string& word, uint64_t& value) {
+        if (word.empty() || word[0] < '0' || word[0] > '9') {
+            return false;
+        }
+        char* end = nullptr;
+        errno = 0;
+        value = std::strtoull(word.c_str(), &end, 10);
+        return errno == 0 && *end == '\0';
+    }
+}
+
+EpollServer::EpollServer(const StoryDefinition& story, int workerCount)
+    : story(story),
+    pool(story, workerCount, [this](int worker, const SessionResponse& response) { OnResponse(worker, response); }),
+    outboxes(pool.GetWorkerCount()),
+    listenFd(-1),
+    epollFd(-1),
+    wakeFd(-1),
+    nextConnection(0),
+    stopping(false)
+{
+    seeds.Seed(static_cast<uint64_t>(std::time(nullptr)));
+}
+
+EpollServer::~EpollServer() {
+    pool.Stop();
+    for (auto& entry : connections) {
+        close(entry.second.fd);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+// Listen on a Unix domain socket, replacing any stale socket file
+bool EpollServer::Listen(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (epollFd < 0 || wakeFd < 0 || listenFd < 0) {
+        std::cerr << "Failed to create server sockets: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    socketPath = path;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = ListenEvent;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.u64 = WakeEvent;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    return true;
+}
+
+// Serve clients until Stop is called
+void EpollServer::Run() {
+    pool.Start();
+    epoll_event events[64];
+    while (!stopping.load()) {
+        int count = epoll_wait(epollFd, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            uint64_t data = events[i].data.u64;
+            if (data == ListenEvent) {
+                Accept();
+                continue;
+            }
+            if (data == WakeEvent) {
+                uint64_t value;
+                ssize_t ignored = read(wakeFd, &value, sizeof(value));
+                (void)ignored;
+                Deliver();
+                continue;
+            }
+
+            int id = static_cast<int>(data);
+            auto found = connections.find(id);
+            if (found == connections.end()) {
+                continue; // Closed earlier in this batch
+            }
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                Close(id);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                Write(found->second);
+            }
+            if (events[i].events & EPOLLIN) {
+                if (!Read(found->second)) {
+                    Close(id);
+                    continue;
+                }
+                // Send the errors the line parser answered itself
+                if (!found->second.output.empty() && !found->second.writing) {
+                    Write(found->second);
+                }
+            }
+        }
+    }
+    pool.Stop();
+}
+
+// Ask Run to return
+void EpollServer::Stop() {
+    stopping.store(true);
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+// Called on a worker thread: queue the response for the epoll thread
+void EpollServer::OnResponse(int worker, const SessionResponse& response) {
+    Outbox& outbox = outboxes[worker];
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(outbox.mutex);
+        wasEmpty = outbox.responses.empty();
+        outbox.responses.push_back(response);
+    }
+    // The loop empties the outbox after it wakes, so one wake-up per batch is enough
+    if (wasEmpty) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void EpollServer::Accept() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        int id = nextConnection;
+        nextConnection = (nextConnection + 1) & 0x7FFFFFFF;
+        Connection& connection = connections[id];
+        connection.id = id;
+        connection.fd = fd;
+        connection.writing = false;
+        connection.flushing = false;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = static_cast<uint64_t>(id);
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+// Read what the client sent and handle every complete line. Returns false
+// once the client has closed the connection.
+bool EpollServer::Read(Connection& connection) {
+    char buffer[4096];
+    for (;;) {
+        ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+        if (size > 0) {
+            connection.input.append(buffer, static_cast<size_t>(size));
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return false;
+        }
+        break;
+    }
+
+    size_t start = 0;
+    std::string line;
+    for (;;) {
+        size_t end = connection.input.find('\n', start);
+        if (end == std::string::npos) {
+            break;
+        }
+        line.assign(connection.input, start, end - start);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        HandleLine(connection, line);
+        start = end + 1;
+    }
+    connection.input.erase(0, start);
+    if (connection.input.size() > MaxLineLength) {
+        connection.output += "error line too long\n";
+        connection.input.clear();
+    }
+    return true;
+}
+
+// Write as much pending output as the socket takes; wait for EPOLLOUT for the rest
+void EpollServer::Write(Connection& connection) {
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        ssize_t size = write(connection.fd, connection.output.data() + written, connection.output.size() - written);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break; // EAGAIN, or an error that the next EPOLLHUP reports
+        }
+        written += static_cast<size_t>(size);
+    }
+    connection.output.erase(0, written);
+
+    bool wantWrite = !connection.output.empty();
+    if (wantWrite != connection.writing) {
+        epoll_event event = {};
+        event.events = wantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.u64 = static_cast<uint64_t>(connection.id);
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.writing = wantWrite;
+    }
+}
+
+// Move every response the workers have produced to its connection's output
+void EpollServer::Deliver() {
+    for (Outbox& outbox : outboxes) {
+        {
+            std::lock_guard<std::mutex> lock(outbox.mutex);
+            delivering.swap(outbox.responses);
+        }
+
+        for (const SessionResponse& response : delivering) {
+            auto found = connections.find(response.connection);
+            if (found == connections.end()) {
+                // The client left before its session was made; nobody can end it now
+                if (response.type == SessionRequest::Create && response.status != SessionResponse::UnknownSession) {
+                    pool.Submit({ SessionRequest::End, -1, 0, response.session, 0 });
+                }
+                continue;
+            }
+            Connection& connection = found->second;
+            if (response.type == SessionRequest::Create) {
+                connection.sessions.insert(response.session);
+            }
+            else if (response.type == SessionRequest::End) {
+                connection.sessions.erase(response.session);
+            }
+            FormatResponse(response, connection.output);
+            if (!connection.flushing) {
+                connection.flushing = true;
+                flushList.push_back(connection.id);
+            }
+        }
+        delivering.clear();
+    }
+
+    // One write per connection for everything delivered to it
+    for (int id : flushList) {
+        auto found = connections.find(id);
+        if (found == connections.end()) {
+            continue;
+        }
+        found->second.flushing = false;
+        if (!found->second.writing) {
+            Write(found->second);
+        }
+    }
+    flushList.clear();
+}
+
+// Drop a connection and end the sessions it created
+void EpollServer::Close(int id) {
+    auto found = connections.find(id);
+    if (found == connections.end()) {
+        return;
+    }
+    Connection& connection = found->second;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    close(connection.fd);
+    for (uint64_t session : connection.sessions) {
+        pool.Submit({ SessionRequest::End, -1, 0, session, 0 });
+    }
+    connections.erase(found);
+}
+
+void EpollServer::HandleLine(Connection& connection, const std::string& line) {
+    size_t position = 0;
+    std::string command;
+    std::string word;
+    if (!NextWord(line, position, command)) {
+        return; // Blank line
+    }
+
+    SessionRequest request = { SessionRequest::State, connection.id, 0, 0, 0 };
+    uint64_t number = 0;
+    if (command == "new") {
+        request.type = SessionRequest::Create;
+        if (NextWord(line, position, word)) {
+            if (!ParseNumber(word, number) || number > UINT32_MAX) {
+                connection.output += "error bad tag\n";
+                return;
+            }
+            request.tag = static_cast<uint32_t>(number);
+        }
+        request.value = seeds.Next();
+        if (NextWord(line, position, word)) {
+            if (!ParseNumber(word, request.value)) {
+                connection.output += "error bad seed\n";
+                return;
+            }
+        }
+        pool.Submit(request);
+        return;
+    }
+
+    if (command == "choose") {
+        request.type = SessionRequest::Choose;
+    }
+    else if (command == "state") {
+        request.type = SessionRequest::State;
+    }
+    else if (command == "restart") {
+        request.type = SessionRequest::Restart;
+    }
+    else if (command == "end") {
+        request.type = SessionRequest::End;
+    }
+    else {
+        connection.output += "error unknown command\n";
+        return;
+    }
+
+    if (!NextWord(line, position, word) || !ParseNumber(word, request.session)) {
+        connection.output += "error bad session\n";
+        return;
+    }
+    // Sessions are only reachable from the connection that created them
+    if (connection.sessions.count(request.session) == 0) {
+        connection.output += "unknown " + word + "\n";
+        return;
+    }
+    if (request.type == SessionRequest::Choose) {
+        if (!NextWord(line, position, word) || !ParseNumber(word, number) || number > INT32_MAX) {
+            connection.output += "error bad choice\n";
+            return;
+        }
+        request.value = number;
+    }
+    pool.Submit(request);
+}
+
+void EpollServer::FormatResponse(const SessionResponse& response, std::string& output) const {
+    static const char* const statusNames[] = { "ok", "over", "bad", "unknown" };
+
+    if (response.type == SessionRequest::Create) {
+        output += "new ";
+        output += std::to_string(response.tag);
+    }
+    else if (response.type == SessionRequest::End && response.status != SessionResponse::UnknownSession) {
+        output += "ended ";
+        output += std::to_string(response.session);
+        output += '\n';
+        return;
+    }
+    else {
+        output += statusNames[response.status];
+    }
+
+    output += ' ';
+    output += std::to_string(response.session);
+    if (response.status != SessionResponse::UnknownSession) {
+        output += ' ';
+        output += story.GetGraph().GetNodeName(response.node);
+        output += ' ';
+        output += std::to_string(response.optionCount);
+    }
+    output += '\n';
+}
+
+#endif // __linux__
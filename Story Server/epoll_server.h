@@ -0,0 +1,94 @@
+#ifndef EPOLL_SERVER_H
+#define EPOLL_SERVER_H
+
+// Socket front end of the story server. It uses epoll and Unix domain
+// sockets, so it is only built on Linux; the session pool and the benchmark
+// work everywhere.
+#ifdef __linux__
+
+#include "random_generator.h"
+#include "session_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Serves sessions to clients over a local stream socket. One thread runs the
+// epoll loop: it accepts connections, reads and parses requests and writes
+// responses. The sessions themselves run on a SessionPool; its workers hand
+// results back through per-worker outboxes and wake the loop with an eventfd.
+//
+// The protocol is one command per line, answered by one line:
+//   new [tag] [seed]      -> new <tag> <session> <node> <options>
+//   choose <session> <n>  -> <status> <session> <node> <options>
+//   state <session>       -> <status> <session> <node> <options>
+//   restart <session>     -> <status> <session> <node> <options>
+//   end <session>         -> ended <session>
+// where status is ok, over (at an ending), bad (no such option) or unknown
+// (no such session). A malformed command is answered with "error <reason>".
+// Answers for one session come in order; answers for different sessions may
+// interleave, which is what the tag of "new" is for.
+class EpollServer {
+public:
+    EpollServer(const StoryDefinition& story, int workerCount);
+    ~EpollServer();
+
+    EpollServer(const EpollServer&) = delete;
+    EpollServer& operator=(const EpollServer&) = delete;
+
+    // Listen on a Unix domain socket, replacing any stale socket file
+    bool Listen(const std::string& socketPath);
+
+    // Serve clients until Stop is called
+    void Run();
+
+    // Ask Run to return (safe to call from any thread or a signal handler)
+    void Stop();
+
+private:
+    struct Connection {
+        int id;
+        int fd;
+        std::string input;  // Bytes read but not yet parsed into commands
+        std::string output; // Responses not yet written
+        bool writing;       // Registered for EPOLLOUT
+        bool flushing;      // Listed in flushList
+        std::unordered_set<uint64_t> sessions; // Sessions it created, ended when it closes
+    };
+
+    // Responses one worker has produced and the loop has not yet delivered
+    struct Outbox {
+        std::mutex mutex;
+        std::vector<SessionResponse> responses;
+    };
+
+    void OnResponse(int worker, const SessionResponse& response);
+    void Accept();
+    bool Read(Connection& connection);
+    void Write(Connection& connection);
+    void Deliver();
+    void Close(int id);
+    void HandleLine(Connection& connection, const std::string& line);
+    void FormatResponse(const SessionResponse& response, std::string& output) const;
+
+    const StoryDefinition& story;
+    SessionPool pool;
+    std::vector<Outbox> outboxes;
+    std::unordered_map<int, Connection> connections; // By connection id
+    std::vector<SessionResponse> delivering;         // Swapped with an outbox while delivering
+    std::vector<int> flushList;                      // Connections given output while delivering
+    RandomGenerator seeds;                           // Seeds of sessions created without one
+    std::string socketPath;
+    int listenFd;
+    int epollFd;
+    int wakeFd;        // eventfd written by the workers and Stop
+    int nextConnection;
+    std::atomic<bool> stopping;
+};
+
+#endif // __linux__
+
+#endif // EPOLL_SERVER_H
@@ -0,0 +1,200 @@
+#include "session_pool.h"
+#include <stdexcept>
+#include <utility>
+
+SessionPool::Slot::Slot(const StoryDefinition& story)
+    : session(story),
+    generation(0),
+    live(false)
+{
+}
+
+SessionPool::SessionPool(const StoryDefinition& story, int workerCount, ResponseHandler handler)
+    : story(story),
+    handler(std::move(handler)),
+    workers(workerCount < 1 ? 1 : workerCount),
+    nextCreateWorker(0)
+{
+}
+
+SessionPool::~SessionPool() {
+    Stop();
+}
+
+void SessionPool::Start() {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        Worker& worker = workers[i];
+        worker.stopping = false;
+        worker.thread = std::thread(&SessionPool::Run, this, static_cast<int>(i));
+    }
+}
+
+// Finish every request already submitted, then join the workers
+void SessionPool::Stop() {
+    for (Worker& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.stopping = true;
+        worker.wake.notify_one();
+    }
+    for (Worker& worker : workers) {
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+    }
+}
+
+// Queue a request on the worker that owns its session
+void SessionPool::Submit(const SessionRequest& request) {
+    uint32_t workerCount = static_cast<uint32_t>(workers.size());
+    uint32_t index;
+    if (request.type == SessionRequest::Create) {
+        index = nextCreateWorker.fetch_add(1, std::memory_order_relaxed) % workerCount;
+    }
+    else {
+        index = static_cast<uint32_t>(request.session) % workerCount;
+    }
+
+    Worker& worker = workers[index];
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        wasEmpty = worker.pending.empty();
+        worker.pending.push_back(request);
+    }
+    // A worker with requests already queued is awake or about to be
+    if (wasEmpty) {
+        worker.wake.notify_one();
+    }
+}
+
+int SessionPool::GetWorkerCount() const {
+    return static_cast<int>(workers.size());
+}
+
+size_t SessionPool::GetSessionCount() const {
+    size_t count = 0;
+    for (const Worker& worker : workers) {
+        count += worker.slots.size() - worker.freeSlots.size();
+    }
+    return count;
+}
+
+size_t SessionPool::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (const Worker& worker : workers) {
+        for (const Slot& slot : worker.slots) {
+            if (slot.live) {
+                bytes += slot.session.GetMemoryUsage() - sizeof(StorySession) + sizeof(Slot);
+            }
+        }
+    }
+    return bytes;
+}
+
+// Worker loop: take every queued request at once and answer them in order
+void SessionPool::Run(int index) {
+    Worker& worker = workers[index];
+    std::vector<SessionRequest> batch;
+    SessionResponse response;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&worker] { return worker.stopping || !worker.pending.empty(); });
+            if (worker.pending.empty()) {
+                return; // Stopping, and nothing left to answer
+            }
+            // Swap rather than copy, so both vectors keep their capacity
+            batch.swap(worker.pending);
+        }
+
+        for (const SessionRequest& request : batch) {
+            Handle(index, request, response);
+            handler(index, response);
+        }
+        batch.clear();
+    }
+}
+
+void SessionPool::Handle(int index, const SessionRequest& request, SessionResponse& response) {
+    Worker& worker = workers[index];
+    response.type = request.type;
+    response.connection = request.connection;
+    response.tag = request.tag;
+    response.session = request.session;
+    response.node = StoryGraph::InvalidNode;
+    response.optionCount = 0;
+
+    Slot* slot = nullptr;
+    if (request.type == SessionRequest::Create) {
+        // Reuse a free slot if there is one
+        uint32_t slotIndex;
+        if (!worker.freeSlots.empty()) {
+            slotIndex = worker.freeSlots.back();
+            worker.freeSlots.pop_back();
+        }
+        else {
+            slotIndex = static_cast<uint32_t>(worker.slots.size());
+            worker.slots.emplace_back(story);
+        }
+        slot = &worker.slots[slotIndex];
+        slot->live = true;
+        slot->session.SetRandomSeed(request.value);
+        slot->session.Restart();
+        uint32_t low = slotIndex * static_cast<uint32_t>(workers.size()) + static_cast<uint32_t>(index);
+        response.session = (static_cast<uint64_t>(slot->generation) << 32) | low;
+    }
+    else {
+        slot = FindSlot(index, request.session);
+        if (slot == nullptr) {
+            response.status = SessionResponse::UnknownSession;
+            return;
+        }
+    }
+
+    StorySession& session = slot->session;
+    response.status = SessionResponse::Ok;
+    switch (request.type) {
+    case SessionRequest::Choose:
+        if (!session.IsGameOver()) {
+            try {
+                session.Choose(static_cast<int>(request.value));
+            }
+            catch (const std::out_of_range&) {
+                response.status = SessionResponse::BadChoice;
+            }
+        }
+        break;
+    case SessionRequest::Restart:
+        session.Restart();
+        break;
+    case SessionRequest::End:
+        // Free the slot; the next id handed out for it has a new generation
+        slot->live = false;
+        ++slot->generation;
+        worker.freeSlots.push_back(static_cast<uint32_t>(slot - worker.slots.data()));
+        return;
+    default:
+        break;
+    }
+
+    response.node = session.GetCurrentNode();
+    response.optionCount = session.GetOptionCount();
+    if (response.status == SessionResponse::Ok && session.IsGameOver()) {
+        response.status = SessionResponse::GameOver;
+    }
+}
+
+// Session of this worker with the given id, or nullptr if it is not live
+SessionPool::Slot* SessionPool::FindSlot(int index, uint64_t session) {
+    Worker& worker = workers[index];
+    uint32_t low = static_cast<uint32_t>(session);
+    uint32_t slotIndex = low / static_cast<uint32_t>(workers.size());
+    if (slotIndex >= worker.slots.size()) {
+        return nullptr;
+    }
+    Slot& slot = worker.slots[slotIndex];
+    if (!slot.live || slot.generation != static_cast<uint32_t>(session >> 32)) {
+        return nullptr;
+    }
+    return &slot;
+}
@@ -0,0 +1,119 @@
+#ifndef SESSION_POOL_H
+#define SESSION_POOL_H
+
+#include "story_definition.h"
+#include "story_session.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A request for one session
+struct SessionRequest {
+    enum Type : uint8_t {
+        Create,  // Start a new session at "start" (value is its random seed)
+        Choose,  // Take a shown option (value is the choice, 1 based)
+        State,   // Report where the session is
+        Restart, // Send the session back to "start"
+        End      // Free the session
+    };
+
+    Type type;
+    int connection;   // Passed back in the response
+    uint32_t tag;     // Passed back in the response
+    uint64_t session; // Session id (ignored by Create)
+    uint64_t value;
+};
+
+// The result of one request
+struct SessionResponse {
+    enum Status : uint8_t {
+        Ok,
+        GameOver,       // The session is at an ending
+        BadChoice,      // No such option; the session did not move
+        UnknownSession  // No session with that id (or it has ended)
+    };
+
+    Status status;
+    SessionRequest::Type type; // Request this answers
+    int connection;
+    uint32_t tag;
+    uint64_t session;
+    int node;         // Current node (InvalidNode if the session is unknown or ended)
+    int optionCount;  // Options shown at the current node
+};
+
+// Runs any number of StorySessions of one shared StoryDefinition on a fixed
+// set of worker threads. Every session belongs to one worker for its whole
+// life and only that worker touches it, so sessions need no locks and stay in
+// that worker's cache. A session id names its owner (the low 32 bits are
+// slot * workerCount + worker), so a request is routed with one division.
+// The high 32 bits are the slot's generation, so the id of an ended session
+// is not mistaken for whoever reuses its slot.
+//
+// Responses are handed to the callback on the worker thread that owns the
+// session, in the order its requests were submitted. The callback may submit
+// more requests.
+class SessionPool {
+public:
+    // worker is the index of the calling worker thread (0 to workerCount - 1)
+    using ResponseHandler = std::function<void(int worker, const SessionResponse& response)>;
+
+    // The definition must be loaded and outlive the pool
+    SessionPool(const StoryDefinition& story, int workerCount, ResponseHandler handler);
+    ~SessionPool();
+
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    void Start();
+
+    // Finish every request already submitted, then join the workers
+    void Stop();
+
+    // Queue a request on the worker that owns its session. New sessions are
+    // spread over the workers in turn.
+    void Submit(const SessionRequest& request);
+
+    int GetWorkerCount() const;
+
+    // Live sessions and the bytes they use (only valid while stopped)
+    size_t GetSessionCount() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Slot {
+        explicit Slot(const StoryDefinition& story);
+
+        StorySession session;
+        uint32_t generation; // Bumped every time the slot is freed
+        bool live;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<SessionRequest> pending; // Filled by Submit, swapped out by the worker
+        bool stopping = false;
+
+        // Only touched by the worker's own thread
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+        std::thread thread;
+    };
+
+    void Run(int index);
+    void Handle(int index, const SessionRequest& request, SessionResponse& response);
+    Slot* FindSlot(int index, uint64_t session);
+
+    const StoryDefinition& story;
+    ResponseHandler handler;
+    std::vector<Worker> workers;
+    std::atomic<uint32_t> nextCreateWorker; // Worker that gets the next new session
+};
+
+#endif // SESSION_POOL_H
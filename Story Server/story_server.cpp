@@ -0,0 +1,216 @@
+// Multi-session story server: one shared story, any number of players, each
+// with a small StorySession running on a fixed pool of worker threads.
+//
+// Usage: "Story Server" [--story file] [--workers N] [--socket path]
+//        "Story Server" --benchmark [--story file] [--workers N] [--sessions N] [--turns N]
+//   --socket path   Unix domain socket to serve on (default story_server.sock, Linux only)
+//   --workers N     worker threads (default: all cores); the benchmark runs 1, 2, 4 ... N
+//   --sessions N    concurrent sessions in the benchmark (default 10000)
+//   --turns N       choices made per benchmark run (default 2000000)
+//
+// The benchmark drives the pool directly, without sockets: every session
+// makes a random choice as soon as the previous one is answered, and starts
+// again when its game ends.
+#include "session_pool.h"
+#include "epoll_server.h"
+#include "story_definition.h"
+#include "random_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    void PrintUsage() {
+        std::cerr << "Usage: StoryServer [--story file] [--workers N] [--socket path]" << std::endl;
+        std::cerr << "       StoryServer --benchmark [--story file] [--workers N] [--sessions N] [--turns N]" << std::endl;
+    }
+
+    // What one benchmark worker has done; padded so workers do not share cache lines
+    struct alignas(64) BenchmarkWorker {
+        uint64_t turns = 0;
+        bool done = false;
+        RandomGenerator random;
+    };
+
+    struct BenchmarkResult {
+        double seconds;
+        uint64_t turns;
+        size_t sessions;
+        size_t sessionBytes;
+    };
+
+    BenchmarkResult RunBenchmark(const StoryDefinition& story, int workerCount, int sessionCount, uint64_t turns) {
+        // Sessions are handed out to the workers in turn, so with fewer sessions
+        // than workers only the first sessionCount workers have any to play
+        std::vector<BenchmarkWorker> stats(workerCount);
+        int busyWorkers = std::min(workerCount, sessionCount);
+        uint64_t budget = (turns + busyWorkers - 1) / busyWorkers;
+        std::mutex finishedMutex;
+        std::condition_variable finishedChanged;
+        int finished = 0;
+
+        SessionPool* poolPointer = nullptr;
+        auto handler = [&](int worker, const SessionResponse& response) {
+            BenchmarkWorker& own = stats[worker];
+            if (response.type == SessionRequest::Choose) {
+                ++own.turns;
+            }
+            if (own.turns >= budget) {
+                if (!own.done) {
+                    own.done = true;
+                    std::lock_guard<std::mutex> lock(finishedMutex);
+                    ++finished;
+                    finishedChanged.notify_one();
+                }
+                return; // Leave the session where it is
+            }
+
+            // The session is owned by this worker, so this goes straight back onto its own queue
+            SessionRequest request = { SessionRequest::Choose, 0, 0, response.session, 0 };
+            if (response.status == SessionResponse::GameOver || response.optionCount == 0) {
+                request.type = SessionRequest::Restart;
+            }
+            else {
+                request.value = own.random.NextBelow(static_cast<uint32_t>(response.optionCount)) + 1;
+            }
+            poolPointer->Submit(request);
+        };
+
+        SessionPool pool(story, workerCount, handler);
+        poolPointer = &pool;
+        for (int i = 0; i < workerCount; ++i) {
+            stats[i].random.Seed(static_cast<uint64_t>(i) + 1);
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        pool.Start();
+        for (int i = 0; i < sessionCount; ++i) {
+            pool.Submit({ SessionRequest::Create, 0, static_cast<uint32_t>(i), 0, static_cast<uint64_t>(i) + 1 });
+        }
+        {
+            std::unique_lock<std::mutex> lock(finishedMutex);
+            finishedChanged.wait(lock, [&] { return finished == busyWorkers; });
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        pool.Stop();
+
+        BenchmarkResult result = { seconds, 0, pool.GetSessionCount(), pool.GetMemoryUsage() };
+        for (const BenchmarkWorker& worker : stats) {
+            result.turns += worker.turns;
+        }
+        return result;
+    }
+
+#ifdef __linux__
+    EpollServer* runningServer = nullptr;
+
+    void OnSignal(int) {
+        if (runningServer != nullptr) {
+            runningServer->Stop();
+        }
+    }
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    std::string storyFile = "assets/stories/preludium damnatio.story";
+    std::string socketPath = "story_server.sock";
+    int workerCount = static_cast<int>(std::thread::hardware_concurrency());
+    int sessionCount = 10000;
+    long long turns = 2000000;
+    bool benchmark = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--story" && i + 1 < argc) {
+            storyFile = argv[++i];
+        }
+        else if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--workers" && i + 1 < argc) {
+            workerCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--sessions" && i + 1 < argc) {
+            sessionCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--turns" && i + 1 < argc) {
+            turns = std::atoll(argv[++i]);
+        }
+        else if (arg == "--benchmark") {
+            benchmark = true;
+        }
+        else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (workerCount < 1) {
+        workerCount = 1;
+    }
+    if (sessionCount < 1 || turns < 1) {
+        PrintUsage();
+        return 2;
+    }
+
+    StoryDefinition story;
+    if (!story.Load(storyFile)) {
+        return 1;
+    }
+
+    if (benchmark) {
+        std::cout << "Story: " << storyFile << " (" << story.GetGraph().GetNodeCount() << " nodes, shared by every session)" << std::endl;
+        std::cout << "Sessions: " << sessionCount << ", turns per run: " << turns << std::endl;
+
+        // 1, 2, 4 ... workers, ending with the requested count
+        std::vector<int> counts;
+        for (int count = 1; count < workerCount; count *= 2) {
+            counts.push_back(count);
+        }
+        counts.push_back(workerCount);
+
+        double baseline = 0.0;
+        for (int count : counts) {
+            BenchmarkResult result = RunBenchmark(story, count, sessionCount, static_cast<uint64_t>(turns));
+            double rate = static_cast<double>(result.turns) / result.seconds;
+            if (baseline == 0.0) {
+                baseline = rate;
+                std::cout << "Memory per session: " << result.sessionBytes / std::max<size_t>(result.sessions, 1)
+                    << " bytes (" << result.sessions << " sessions, " << result.sessionBytes << " bytes)" << std::endl;
+            }
+            std::cout << "Workers: " << count << ", " << result.turns << " turns in " << result.seconds << " s ("
+                << rate << " turns/s, " << rate / baseline << "x)" << std::endl;
+        }
+        if (sessionCount < workerCount) {
+            std::cout << "Note: only " << sessionCount << " worker(s) have a session to run" << std::endl;
+        }
+        if (static_cast<unsigned int>(workerCount) > std::thread::hardware_concurrency()) {
+            std::cout << "Note: more workers than the " << std::thread::hardware_concurrency() << " hardware thread(s) available" << std::endl;
+        }
+        return 0;
+    }
+
+#ifdef __linux__
+    EpollServer server(story, workerCount);
+    if (!server.Listen(socketPath)) {
+        return 1;
+    }
+    runningServer = &server;
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    std::cout << "Serving " << storyFile << " on " << socketPath << " with " << workerCount << " worker(s)" << std::endl;
+    server.Run();
+    runningServer = nullptr;
+    return 0;
+#else
+    std::cerr << "The socket server needs Linux (epoll); only --benchmark is available here." << std::endl;
+    return 1;
+#endif
+}